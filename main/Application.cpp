@@ -10,8 +10,12 @@ LOG_TAG(Application);
 Application::Application(Device* device)
     : _device(device),
       _network_connection(&_queue),
+      _ota_manager(&_http_connection_manager),
       _loading_ui(nullptr),
       _stats_ui(nullptr),
+      _configuration(&_http_connection_manager),
+      _log_manager(&_http_connection_manager),
+      _core_dump_uploader(&_http_connection_manager),
       _have_sntp_synced(false) {}
 
 void Application::begin(bool silent) {
@@ -42,7 +46,13 @@ void Application::do_begin(bool silent) {
     _loading_ui->begin();
     _loading_ui->set_title(MSG_STARTING);
     _loading_ui->set_state(LoadingUIState::Loading);
-    _loading_ui->render();
+
+    // Show the last known statistics while we're connecting. The stats UI
+    // only starts updating once initialization has completed.
+    _stats_ui = new StatsUI(&_http_connection_manager);
+    if (!_stats_ui->load_snapshot()) {
+        _loading_ui->render();
+    }
 
     begin_network();
 }
@@ -83,6 +93,9 @@ void Application::begin_network_available() {
 
     _log_manager.set_configuration(_configuration);
 
+    // Get a core dump out before anything else can crash again.
+    _core_dump_uploader.upload(_configuration);
+
     if (_configuration.get_enable_ota()) {
         _ota_manager.begin();
     }
@@ -106,7 +119,6 @@ void Application::begin_after_initialization() {
 void Application::begin_ui() {
     ESP_LOGI(TAG, "Connected, showing UI");
 
-    _stats_ui = new StatsUI();
     _stats_ui->begin();
 }
 
@@ -115,7 +127,7 @@ void Application::process() {
 
     _queue.process();
 
-    if (_stats_ui) {
+    if (_stats_ui && !_loading_ui) {
         _stats_ui->update();
     }
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "CoreDumpUploader.h"
+#include "HttpConnectionManager.h"
 #include "LoadingUI.h"
 #include "LogManager.h"
 #include "NetworkConnection.h"
@@ -10,6 +12,7 @@
 
 class Application {
     Device* _device;
+    HttpConnectionManager _http_connection_manager;
     NetworkConnection _network_connection;
     OTAManager _ota_manager;
     LoadingUI* _loading_ui;
@@ -17,6 +20,7 @@ class Application {
     Queue _queue;
     DeviceConfiguration _configuration;
     LogManager _log_manager;
+    CoreDumpUploader _core_dump_uploader;
     bool _have_sntp_synced;
 
 public:
@@ -0,0 +1,101 @@
+#include "includes.h"
+
+#ifndef LV_SIMULATOR
+
+#include "CoreDumpUploader.h"
+
+#include "esp_core_dump.h"
+
+LOG_TAG(CoreDumpUploader);
+
+constexpr auto CHUNK_SIZE = 4096;
+
+void CoreDumpUploader::upload(const DeviceConfiguration& configuration) {
+    if (esp_core_dump_image_check() != ESP_OK) {
+        return;
+    }
+
+    log_summary();
+
+    if (!*CONFIG_COREDUMP_ENDPOINT) {
+        return;
+    }
+
+    auto err = upload_image(configuration);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to upload core dump: %s", esp_err_to_name(err));
+        return;
+    }
+
+    ESP_LOGI(TAG, "Uploaded core dump, erasing it");
+
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_core_dump_image_erase());
+}
+
+void CoreDumpUploader::log_summary() {
+    auto summary = new esp_core_dump_summary_t;
+
+    if (esp_core_dump_get_summary(summary) == ESP_OK) {
+        string backtrace;
+        for (uint32_t i = 0; i < summary->exc_bt_info.depth; i++) {
+            backtrace += format(" 0x%08" PRIx32, summary->exc_bt_info.bt[i]);
+        }
+
+        ESP_LOGE(TAG, "Crashed in task %s at 0x%08" PRIx32 ", backtrace:%s%s", summary->exc_task, summary->exc_pc,
+                 backtrace.c_str(), summary->exc_bt_info.corrupted ? " (corrupted)" : "");
+    } else {
+        ESP_LOGE(TAG, "Found a core dump, but failed to get its summary");
+    }
+
+    delete summary;
+}
+
+esp_err_t CoreDumpUploader::upload_image(const DeviceConfiguration& configuration) {
+    size_t address;
+    size_t size;
+    auto err = esp_core_dump_image_get(&address, &size);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_COREDUMP, nullptr);
+    if (!partition) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const auto url = format(CONFIG_COREDUMP_ENDPOINT, configuration.get_device_entity_id().c_str());
+
+    esp_http_client_config_t config = {
+        .url = url.c_str(),
+        .timeout_ms = CONFIG_LOG_RECV_TIMEOUT,
+    };
+
+    ESP_LOGI(TAG, "Uploading %d byte core dump to %s", (int)size, config.url);
+
+    auto buffer = new uint8_t[CHUNK_SIZE];
+
+    // Stream the image straight from flash.
+    err = _http_connection_manager->post(config, size, nullptr, [&](esp_http_client_handle_t client) {
+        for (size_t offset = 0; offset < size;) {
+            const auto length = min(size - offset, (size_t)CHUNK_SIZE);
+
+            auto read_err = esp_partition_read(partition, address - partition->address + offset, buffer, length);
+            if (read_err != ESP_OK) {
+                return read_err;
+            }
+            if (esp_http_client_write(client, (const char*)buffer, length) != (int)length) {
+                return ESP_ERR_HTTP_WRITE_DATA;
+            }
+
+            offset += length;
+        }
+
+        return ESP_OK;
+    });
+
+    delete[] buffer;
+
+    return err;
+}
+
+#endif
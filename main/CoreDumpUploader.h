@@ -0,0 +1,26 @@
+#pragma once
+
+#ifndef LV_SIMULATOR
+
+#include "DeviceConfiguration.h"
+#include "HttpConnectionManager.h"
+
+// Uploads the core dump a crash left in the coredump partition. The crash
+// summary with the backtrace is logged first, so it reaches the log
+// endpoint even when the core dump itself can't be uploaded. The core dump
+// is erased once the endpoint has accepted it.
+class CoreDumpUploader {
+    HttpConnectionManager* _http_connection_manager;
+
+public:
+    CoreDumpUploader(HttpConnectionManager* http_connection_manager)
+        : _http_connection_manager(http_connection_manager) {}
+
+    void upload(const DeviceConfiguration& configuration);
+
+private:
+    void log_summary();
+    esp_err_t upload_image(const DeviceConfiguration& configuration);
+};
+
+#endif
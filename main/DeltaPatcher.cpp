@@ -0,0 +1,184 @@
+#include "includes.h"
+
+#include "DeltaPatcher.h"
+
+DeltaPatcher::DeltaPatcher(Source source, Sink sink)
+    : _source(source),
+      _sink(sink),
+      _state(State::Header),
+      _field_length(0),
+      _remaining(0),
+      _source_version(),
+      _source_size(0),
+      _target_size(0),
+      _target_sha256(),
+      _written(0),
+      _copy_buffer(new uint8_t[COPY_BUFFER_SIZE]) {}
+
+DeltaPatcher::~DeltaPatcher() { delete[] _copy_buffer; }
+
+esp_err_t DeltaPatcher::write(const uint8_t *data, size_t length) {
+    while (length > 0) {
+        switch (_state) {
+            case State::Header: {
+                if (!read_field(data, length, HEADER_SIZE)) {
+                    return ESP_OK;
+                }
+
+                auto err = parse_header();
+                if (err != ESP_OK) {
+                    return err;
+                }
+
+                _state = State::Opcode;
+                break;
+            }
+
+            case State::Opcode:
+                switch (*data) {
+                    case OPCODE_END:
+                        _state = State::Done;
+                        break;
+                    case OPCODE_COPY:
+                        _state = State::Copy;
+                        break;
+                    case OPCODE_INSERT:
+                        _state = State::InsertLength;
+                        break;
+                    default:
+                        return ESP_ERR_INVALID_ARG;
+                }
+
+                data++;
+                length--;
+                break;
+
+            case State::Copy: {
+                if (!read_field(data, length, 8)) {
+                    return ESP_OK;
+                }
+
+                auto err = copy(read_u32(_field), read_u32(_field + 4));
+                if (err != ESP_OK) {
+                    return err;
+                }
+
+                _state = State::Opcode;
+                break;
+            }
+
+            case State::InsertLength:
+                if (!read_field(data, length, 4)) {
+                    return ESP_OK;
+                }
+
+                _remaining = read_u32(_field);
+                _state = _remaining ? State::Insert : State::Opcode;
+                break;
+
+            case State::Insert: {
+                const auto chunk = min(length, _remaining);
+
+                auto err = emit(data, chunk);
+                if (err != ESP_OK) {
+                    return err;
+                }
+
+                data += chunk;
+                length -= chunk;
+                _remaining -= chunk;
+
+                if (!_remaining) {
+                    _state = State::Opcode;
+                }
+                break;
+            }
+
+            case State::Done:
+                // Nothing may follow the end of the patch.
+                return ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t DeltaPatcher::finish() {
+    if (_state != State::Done || _written != _target_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    return ESP_OK;
+}
+
+bool DeltaPatcher::read_field(const uint8_t *&data, size_t &length, size_t size) {
+    const auto chunk = min(length, size - _field_length);
+
+    memcpy(_field + _field_length, data, chunk);
+
+    _field_length += chunk;
+    data += chunk;
+    length -= chunk;
+
+    if (_field_length < size) {
+        return false;
+    }
+
+    _field_length = 0;
+    return true;
+}
+
+esp_err_t DeltaPatcher::parse_header() {
+    if (read_u32(_field) != MAGIC) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    auto p = _field + 4;
+
+    memcpy(_source_version, p, VERSION_SIZE);
+    _source_version[VERSION_SIZE] = 0;
+    p += VERSION_SIZE;
+
+    _source_size = read_u32(p);
+    p += 4;
+
+    _target_size = read_u32(p);
+    p += 4;
+
+    memcpy(_target_sha256, p, HASH_SIZE);
+
+    return ESP_OK;
+}
+
+esp_err_t DeltaPatcher::copy(uint32_t offset, uint32_t length) {
+    if ((uint64_t)offset + length > _source_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    while (length > 0) {
+        const auto chunk = min((size_t)length, COPY_BUFFER_SIZE);
+
+        auto err = _source(offset, _copy_buffer, chunk);
+        if (err == ESP_OK) {
+            err = emit(_copy_buffer, chunk);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        offset += chunk;
+        length -= chunk;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t DeltaPatcher::emit(const uint8_t *data, size_t length) {
+    if (_written + length > _target_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    _written += length;
+
+    return _sink(data, length);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+// Applies a delta patch to the running firmware image while the patch is
+// being received. The patch is fed in chunks of any size through write();
+// the target image is produced in order through the sink. Memory use is
+// bounded by a single copy buffer.
+//
+// A patch starts with a header (all numbers little endian):
+//
+//   magic           "OTAD"
+//   source_version  char[32], the esp_app_desc_t version of the source
+//   source_size     u32
+//   target_size     u32
+//   target_sha256   u8[32], SHA-256 of the complete target image
+//
+// followed by commands, each an opcode byte and its arguments:
+//
+//   COPY    u32 offset, u32 length: copy length bytes from the source
+//   INSERT  u32 length, length bytes: insert the bytes
+//   END     marks the end of the patch
+//
+// scripts/ota-delta.py creates patches.
+class DeltaPatcher {
+public:
+    static constexpr size_t VERSION_SIZE = 32;
+    static constexpr size_t HASH_SIZE = 32;
+    static constexpr size_t HEADER_SIZE = 4 + VERSION_SIZE + 4 + 4 + HASH_SIZE;
+
+    using Source = function<esp_err_t(size_t offset, uint8_t *target, size_t length)>;
+    using Sink = function<esp_err_t(const uint8_t *data, size_t length)>;
+
+private:
+    static constexpr uint32_t MAGIC = 0x4441544f;  // "OTAD"
+    static constexpr size_t COPY_BUFFER_SIZE = 4096;
+
+    enum class State { Header, Opcode, Copy, InsertLength, Insert, Done };
+    enum Opcode : uint8_t { OPCODE_END = 0, OPCODE_COPY = 1, OPCODE_INSERT = 2 };
+
+    Source _source;
+    Sink _sink;
+    State _state;
+    uint8_t _field[HEADER_SIZE];
+    size_t _field_length;
+    size_t _remaining;
+    char _source_version[VERSION_SIZE + 1];
+    uint32_t _source_size;
+    uint32_t _target_size;
+    uint8_t _target_sha256[HASH_SIZE];
+    size_t _written;
+    uint8_t *_copy_buffer;
+
+public:
+    DeltaPatcher(Source source, Sink sink);
+    DeltaPatcher(const DeltaPatcher &) = delete;
+    DeltaPatcher &operator=(const DeltaPatcher &) = delete;
+    DeltaPatcher(DeltaPatcher &&) = delete;
+    DeltaPatcher &operator=(DeltaPatcher &&) = delete;
+    ~DeltaPatcher();
+
+    esp_err_t write(const uint8_t *data, size_t length);
+    // Fails when the patch was incomplete.
+    esp_err_t finish();
+
+    // Valid once has_header() returns true.
+    bool has_header() const { return _state != State::Header; }
+    const char *get_source_version() const { return _source_version; }
+    uint32_t get_source_size() const { return _source_size; }
+    uint32_t get_target_size() const { return _target_size; }
+    const uint8_t *get_target_sha256() const { return _target_sha256; }
+
+private:
+    bool read_field(const uint8_t *&data, size_t &length, size_t size);
+    esp_err_t parse_header();
+    esp_err_t copy(uint32_t offset, uint32_t length);
+    esp_err_t emit(const uint8_t *data, size_t length);
+    static uint32_t read_u32(const uint8_t *data) {
+        return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+    }
+};
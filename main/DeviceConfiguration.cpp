@@ -4,7 +4,8 @@
 
 static const char* TAG = "DeviceConfiguration";
 
-DeviceConfiguration::DeviceConfiguration() : _enable_ota(DEFAULT_ENABLE_OTA) {
+DeviceConfiguration::DeviceConfiguration(HttpConnectionManager* http_connection_manager)
+    : _http_connection_manager(http_connection_manager), _enable_ota(DEFAULT_ENABLE_OTA) {
     uint8_t mac[6];
 
     ESP_ERROR_CHECK(esp_read_mac(mac, ESP_MAC_WIFI_STA));
@@ -23,7 +24,7 @@ esp_err_t DeviceConfiguration::load() {
     ESP_LOGI(TAG, "Getting device configuration from %s", config.url);
 
     string json;
-    auto err = esp_http_download_string(config, json, 128 * 1024);
+    auto err = _http_connection_manager->download_string(config, json, 128 * 1024);
     if (err != ESP_OK) {
         return err;
     }
@@ -67,5 +68,83 @@ esp_err_t DeviceConfiguration::load() {
 
     ESP_LOGI(TAG, "Enable OTA: %s", _enable_ota ? "yes" : "no");
 
+    // Maps tags to a level and/or a rate limit, e.g.
+    // {"wifi": {"level": "warn", "rate": 0.5, "burst": 5}}. The level of "*"
+    // applies to all tags, its rate limit to the tags without one.
+    auto logFiltersItem = cJSON_GetObjectItemCaseSensitive(*data, "logFilters");
+    if (logFiltersItem != nullptr) {
+        if (!cJSON_IsObject(logFiltersItem)) {
+            ESP_LOGE(TAG, "Cannot get logFilters property");
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        _log_filters.clear();
+
+        cJSON* filterItem;
+        cJSON_ArrayForEach(filterItem, logFiltersItem) {
+            LogFilterConfiguration filter = {
+                .tag = filterItem->string,
+                .level = -1,
+                .rate = 0,
+                .burst = 1,
+            };
+
+            err = parse_log_filter(filterItem, filter);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Invalid log filter for tag %s", filterItem->string);
+                return err;
+            }
+
+            _log_filters.push_back(move(filter));
+        }
+    }
+
+    ESP_LOGI(TAG, "Log filters: %d", (int)_log_filters.size());
+
     return ERR_OK;
-}
\ No newline at end of file
+}
+
+esp_err_t DeviceConfiguration::parse_log_filter(cJSON* item, LogFilterConfiguration& filter) {
+    static const char* LEVELS[] = {"none", "error", "warn", "info", "debug", "verbose"};
+
+    if (!cJSON_IsObject(item)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    auto levelItem = cJSON_GetObjectItemCaseSensitive(item, "level");
+    if (levelItem != nullptr) {
+        if (!cJSON_IsString(levelItem) || !levelItem->valuestring) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        for (auto i = 0; i < (int)(sizeof(LEVELS) / sizeof(LEVELS[0])); i++) {
+            if (strcmp(levelItem->valuestring, LEVELS[i]) == 0) {
+                filter.level = i;
+            }
+        }
+
+        if (filter.level < 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    auto rateItem = cJSON_GetObjectItemCaseSensitive(item, "rate");
+    if (rateItem != nullptr) {
+        if (!cJSON_IsNumber(rateItem) || rateItem->valuedouble < 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        filter.rate = rateItem->valuedouble;
+    }
+
+    auto burstItem = cJSON_GetObjectItemCaseSensitive(item, "burst");
+    if (burstItem != nullptr) {
+        if (!cJSON_IsNumber(burstItem) || burstItem->valueint < 1) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        filter.burst = (uint32_t)burstItem->valueint;
+    }
+
+    return ESP_OK;
+}
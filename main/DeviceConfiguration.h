@@ -1,16 +1,29 @@
 #pragma once
 
+#include "HttpConnectionManager.h"
+
+struct LogFilterConfiguration {
+    string tag;
+    // Level for the tag, or -1 to keep the default.
+    int level;
+    // Messages per second, or zero when the tag isn't rate limited.
+    double rate;
+    uint32_t burst;
+};
+
 class DeviceConfiguration {
 private:
     static constexpr auto DEFAULT_ENABLE_OTA = true;
 
+    HttpConnectionManager* _http_connection_manager;
     string _device_name;
     string _device_entity_id;
     string _endpoint;
     bool _enable_ota;
+    vector<LogFilterConfiguration> _log_filters;
 
 public:
-    DeviceConfiguration();
+    DeviceConfiguration(HttpConnectionManager* http_connection_manager);
     DeviceConfiguration(const DeviceConfiguration&) = delete;
     DeviceConfiguration& operator=(const DeviceConfiguration&) = delete;
     DeviceConfiguration(DeviceConfiguration&&) = delete;
@@ -22,4 +35,8 @@ public:
     const string& get_device_name() const { return _device_name; }
     const string& get_device_entity_id() const { return _device_entity_id; }
     bool get_enable_ota() const { return _enable_ota; }
+    const vector<LogFilterConfiguration>& get_log_filters() const { return _log_filters; }
+
+private:
+    static esp_err_t parse_log_filter(cJSON* item, LogFilterConfiguration& filter);
 };
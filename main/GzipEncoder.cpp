@@ -0,0 +1,189 @@
+#include "includes.h"
+
+#include "GzipEncoder.h"
+
+static const uint16_t LENGTH_BASE[] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                       31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                       2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DISTANCE_BASE[] = {1,    2,    3,    4,    5,    7,     9,     13,    17,    25,
+                                         33,   49,   65,   97,   129,  193,   257,   385,   513,   769,
+                                         1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DISTANCE_EXTRA[] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                         6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+GzipEncoder::GzipEncoder() : _target(nullptr), _bits(0), _bit_count(0) {
+#ifdef LV_SIMULATOR
+    _head = (int32_t*)malloc(sizeof(int32_t) << HASH_BITS);
+#else
+    _head = (int32_t*)heap_caps_malloc(sizeof(int32_t) << HASH_BITS, MALLOC_CAP_SPIRAM);
+#endif
+    if (!_head) {
+        abort();
+    }
+}
+
+GzipEncoder::~GzipEncoder() {
+#ifdef LV_SIMULATOR
+    free(_head);
+#else
+    heap_caps_free(_head);
+#endif
+}
+
+void GzipEncoder::encode(const char* data, size_t length, string& target) {
+    // Deflate, no flags, no modification time, unknown OS.
+    static const uint8_t HEADER[] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+
+    target.append((const char*)HEADER, sizeof(HEADER));
+
+    _target = &target;
+    _bits = 0;
+    _bit_count = 0;
+
+    // A single, final block with fixed Huffman codes.
+    write_bits(1, 1);
+    write_bits(1, 2);
+
+    memset(_head, 0xff, sizeof(int32_t) << HASH_BITS);
+
+    const auto input = (const uint8_t*)data;
+    size_t i = 0;
+
+    while (i < length) {
+        uint32_t match_length = 0;
+        uint32_t distance = 0;
+
+        if (i + MIN_MATCH <= length) {
+            const auto key = hash(input + i);
+            const auto candidate = _head[key];
+            _head[key] = (int32_t)i;
+
+            if (candidate >= 0 && i - candidate <= WINDOW_SIZE) {
+                const auto limit = (uint32_t)min(length - i, (size_t)MAX_MATCH);
+                uint32_t n = 0;
+                while (n < limit && input[candidate + n] == input[i + n]) {
+                    n++;
+                }
+                if (n >= MIN_MATCH) {
+                    match_length = n;
+                    distance = i - candidate;
+                }
+            }
+        }
+
+        if (!match_length) {
+            write_symbol(input[i]);
+            i++;
+            continue;
+        }
+
+        write_match(match_length, distance);
+
+        // Index the positions inside the match too, so later matches can
+        // start in it.
+        for (auto j = i + 1; j < i + match_length && j + MIN_MATCH <= length; j++) {
+            _head[hash(input + j)] = (int32_t)j;
+        }
+
+        i += match_length;
+    }
+
+    write_symbol(256);
+    flush_bits();
+
+    const uint32_t trailer[] = {crc32(input, length), (uint32_t)length};
+    for (auto value : trailer) {
+        const char bytes[] = {(char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24)};
+        target.append(bytes, sizeof(bytes));
+    }
+
+    _target = nullptr;
+}
+
+void GzipEncoder::write_bits(uint32_t value, int count) {
+    _bits |= value << _bit_count;
+    _bit_count += count;
+
+    while (_bit_count >= 8) {
+        _target->push_back((char)_bits);
+        _bits >>= 8;
+        _bit_count -= 8;
+    }
+}
+
+void GzipEncoder::write_symbol(uint32_t symbol) {
+    uint32_t code;
+    int count;
+
+    if (symbol < 144) {
+        code = 0x30 + symbol;
+        count = 8;
+    } else if (symbol < 256) {
+        code = 0x190 + symbol - 144;
+        count = 9;
+    } else if (symbol < 280) {
+        code = symbol - 256;
+        count = 7;
+    } else {
+        code = 0xc0 + symbol - 280;
+        count = 8;
+    }
+
+    // Huffman codes are stored starting with their most significant bit.
+    uint32_t reversed = 0;
+    for (auto i = 0; i < count; i++) {
+        reversed = reversed << 1 | ((code >> i) & 1);
+    }
+
+    write_bits(reversed, count);
+}
+
+void GzipEncoder::write_match(uint32_t length, uint32_t distance) {
+    auto index = (int)(sizeof(LENGTH_BASE) / sizeof(LENGTH_BASE[0])) - 1;
+    while (LENGTH_BASE[index] > length) {
+        index--;
+    }
+
+    write_symbol(257 + index);
+    write_bits(length - LENGTH_BASE[index], LENGTH_EXTRA[index]);
+
+    index = (int)(sizeof(DISTANCE_BASE) / sizeof(DISTANCE_BASE[0])) - 1;
+    while (DISTANCE_BASE[index] > distance) {
+        index--;
+    }
+
+    // Distance codes are five bits long.
+    uint32_t reversed = 0;
+    for (auto i = 0; i < 5; i++) {
+        reversed = reversed << 1 | ((index >> i) & 1);
+    }
+
+    write_bits(reversed, 5);
+    write_bits(distance - DISTANCE_BASE[index], DISTANCE_EXTRA[index]);
+}
+
+void GzipEncoder::flush_bits() {
+    if (_bit_count > 0) {
+        _target->push_back((char)_bits);
+    }
+
+    _bits = 0;
+    _bit_count = 0;
+}
+
+uint32_t GzipEncoder::crc32(const uint8_t* data, size_t length) {
+    static const uint32_t TABLE[] = {0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4,
+                                     0x4db26158, 0x5005713c, 0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+                                     0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+
+    uint32_t crc = 0xffffffff;
+
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ TABLE[crc & 0xf];
+        crc = (crc >> 4) ^ TABLE[crc & 0xf];
+    }
+
+    return ~crc;
+}
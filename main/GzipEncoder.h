@@ -0,0 +1,43 @@
+#pragma once
+
+// Compresses a buffer into a gzip member holding a single deflate block with
+// the fixed Huffman codes. Matches are found through a hash table holding
+// the most recent position of every three byte prefix. That's fast and needs
+// little memory, and still catches the keys and values that repeat in every
+// line of a log batch.
+class GzipEncoder {
+    static constexpr int HASH_BITS = 12;
+    static constexpr uint32_t WINDOW_SIZE = 32768;
+    static constexpr uint32_t MIN_MATCH = 3;
+    static constexpr uint32_t MAX_MATCH = 258;
+
+    int32_t* _head;
+    string* _target;
+    uint32_t _bits;
+    int _bit_count;
+
+public:
+    GzipEncoder();
+    GzipEncoder(const GzipEncoder&) = delete;
+    GzipEncoder& operator=(const GzipEncoder&) = delete;
+    GzipEncoder(GzipEncoder&&) = delete;
+    GzipEncoder& operator=(GzipEncoder&&) = delete;
+    ~GzipEncoder();
+
+    // Appends the compressed data to target, which grows by at most
+    // get_max_size(length) bytes.
+    void encode(const char* data, size_t length, string& target);
+
+    // Literals take up to nine bits.
+    static size_t get_max_size(size_t length) { return length + length / 8 + 32; }
+
+private:
+    void write_bits(uint32_t value, int count);
+    void write_symbol(uint32_t symbol);
+    void write_match(uint32_t length, uint32_t distance);
+    void flush_bits();
+    static uint32_t hash(const uint8_t* data) {
+        return ((data[0] << 16 | data[1] << 8 | data[2]) * 2654435761u) >> (32 - HASH_BITS);
+    }
+    static uint32_t crc32(const uint8_t* data, size_t length);
+};
@@ -0,0 +1,265 @@
+#include "includes.h"
+
+#include "HttpConnectionManager.h"
+
+LOG_TAG(HttpConnectionManager);
+
+HttpConnectionManager::HttpConnectionManager()
+    : _requests(0), _reused(0), _connects(0), _reconnects(0), _failures(0) {}
+
+HttpConnectionManager::~HttpConnectionManager() {
+    for (auto connection : _connections) {
+        if (connection->client) {
+            esp_http_client_cleanup(connection->client);
+        }
+        delete connection;
+    }
+}
+
+esp_err_t HttpConnectionManager::download_string(const esp_http_client_config_t& config, string& target,
+                                                 size_t maxLength) {
+    target.clear();
+
+    return get(config,
+               [&target, maxLength](auto client, auto length) { return read_string(client, target, maxLength); });
+}
+
+esp_err_t HttpConnectionManager::read_string(esp_http_client_handle_t client, string& target, size_t maxLength) {
+    constexpr size_t BUFFER_SIZE = 1024;
+    const auto bufferSize = maxLength > 0 ? min(maxLength + 1, BUFFER_SIZE) : BUFFER_SIZE;
+
+    auto buffer = new char[bufferSize];
+    auto err = ESP_OK;
+
+    while (true) {
+        auto read = esp_http_client_read(client, buffer, bufferSize);
+        if (read < 0) {
+            err = -read;
+            break;
+        }
+        if (read == 0) {
+            break;
+        }
+
+        if (maxLength > 0 && target.length() + read > maxLength) {
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+
+        target.append(buffer, read);
+    }
+
+    delete[] buffer;
+
+    return err;
+}
+
+esp_err_t HttpConnectionManager::upload_string(const esp_http_client_config_t& config, const char* data,
+                                               size_t length, const char* content_encoding) {
+    return post(config, length, content_encoding, [data, length](esp_http_client_handle_t client) {
+        return esp_http_client_write(client, data, length) == (int)length ? ESP_OK : ESP_ERR_HTTP_WRITE_DATA;
+    });
+}
+
+esp_err_t HttpConnectionManager::post(const esp_http_client_config_t& config, size_t length,
+                                      const char* content_encoding,
+                                      const function<esp_err_t(esp_http_client_handle_t client)>& func) {
+    auto connection = get_connection(config.url);
+    auto lock = connection->mutex.take();
+
+    _requests++;
+
+    auto err = ESP_OK;
+
+    for (auto attempt = 0;; attempt++) {
+        const auto reused = connection->connected;
+
+        err = prepare(connection, config, HTTP_METHOD_POST);
+        if (err == ESP_OK && content_encoding) {
+            err = esp_http_client_set_header(connection->client, "Content-Encoding", content_encoding);
+        }
+        if (err == ESP_OK) {
+            err = esp_http_client_open(connection->client, length);
+        }
+        if (err == ESP_OK) {
+            err = func(connection->client);
+        }
+        if (err == ESP_OK && esp_http_client_fetch_headers(connection->client) < 0) {
+            err = ESP_ERR_HTTP_FETCH_HEADER;
+        }
+        if (err == ESP_OK) {
+            // Drain the response so the connection can be reused.
+            err = esp_http_client_flush_response(connection->client, nullptr);
+        }
+
+        if (err == ESP_OK) {
+            if (reused) {
+                _reused++;
+            } else {
+                _connects++;
+            }
+            connection->connected = true;
+
+            const auto status = esp_http_client_get_status_code(connection->client);
+            if (status < 200 || status >= 300) {
+                ESP_LOGE(TAG, "POST to %s failed with status %d", config.url, status);
+                _failures++;
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+
+            return ESP_OK;
+        }
+
+        disconnect(connection);
+
+        // A kept alive connection may have been closed by the server. The
+        // request is repeated once on a fresh connection.
+        if (!reused || attempt > 0) {
+            _failures++;
+            return err;
+        }
+
+        ESP_LOGW(TAG, "Kept alive connection to %s failed, reconnecting", connection->origin.c_str());
+
+        _reconnects++;
+    }
+}
+
+esp_err_t HttpConnectionManager::get(
+    const esp_http_client_config_t& config,
+    const function<esp_err_t(esp_http_client_handle_t client, int64_t length)>& func, const char* range) {
+    auto connection = get_connection(config.url);
+    auto lock = connection->mutex.take();
+
+    _requests++;
+
+    auto err = ESP_OK;
+    int64_t length = 0;
+
+    for (auto attempt = 0;; attempt++) {
+        const auto reused = connection->connected;
+
+        err = prepare(connection, config, HTTP_METHOD_GET);
+        if (err == ESP_OK && range) {
+            err = esp_http_client_set_header(connection->client, "Range", range);
+        }
+        if (err == ESP_OK) {
+            err = esp_http_client_open(connection->client, 0);
+        }
+        if (err == ESP_OK) {
+            length = esp_http_client_fetch_headers(connection->client);
+            if (length < 0) {
+                err = ESP_ERR_HTTP_FETCH_HEADER;
+            }
+        }
+
+        if (err == ESP_OK) {
+            if (reused) {
+                _reused++;
+            } else {
+                _connects++;
+            }
+            break;
+        }
+
+        disconnect(connection);
+
+        if (!reused || attempt > 0) {
+            _failures++;
+            return err;
+        }
+
+        ESP_LOGW(TAG, "Kept alive connection to %s failed, reconnecting", connection->origin.c_str());
+
+        _reconnects++;
+    }
+
+    err = func(connection->client, length);
+
+    if (err == ESP_OK && esp_http_client_is_complete_data_received(connection->client)) {
+        connection->connected = true;
+    } else {
+        if (err != ESP_OK) {
+            _failures++;
+        }
+
+        disconnect(connection);
+    }
+
+    return err;
+}
+
+HttpConnectionStatistics HttpConnectionManager::get_statistics() const {
+    return {
+        .requests = _requests,
+        .reused = _reused,
+        .connects = _connects,
+        .reconnects = _reconnects,
+        .failures = _failures,
+    };
+}
+
+void HttpConnectionManager::log_statistics() const {
+    const auto statistics = get_statistics();
+
+    ESP_LOGI(TAG, "HTTP requests %" PRIu32 ", reused %" PRIu32 ", connects %" PRIu32 ", reconnects %" PRIu32
+                  ", failures %" PRIu32,
+             statistics.requests, statistics.reused, statistics.connects, statistics.reconnects,
+             statistics.failures);
+}
+
+HttpConnectionManager::Connection* HttpConnectionManager::get_connection(const char* url) {
+    auto origin = get_origin(url);
+
+    auto lock = _mutex.take();
+
+    for (auto connection : _connections) {
+        if (connection->origin == origin) {
+            return connection;
+        }
+    }
+
+    auto connection = new Connection(move(origin));
+    _connections.push_back(connection);
+
+    return connection;
+}
+
+esp_err_t HttpConnectionManager::prepare(Connection* connection, const esp_http_client_config_t& config,
+                                         esp_http_client_method_t method) {
+    if (!connection->client) {
+        connection->client = esp_http_client_init(&config);
+        if (!connection->client) {
+            return ESP_ERR_NO_MEM;
+        }
+    } else {
+        // The URL is always on the same origin, so this doesn't close the
+        // connection.
+        ESP_ERROR_CHECK_WITHOUT_ABORT(esp_http_client_set_url(connection->client, config.url));
+        ESP_ERROR_CHECK_WITHOUT_ABORT(esp_http_client_set_timeout_ms(connection->client, config.timeout_ms));
+
+        // Headers stick to the kept alive client. Remove the ones an earlier
+        // request may have set.
+        esp_http_client_delete_header(connection->client, "Range");
+        esp_http_client_delete_header(connection->client, "Content-Encoding");
+    }
+
+    return esp_http_client_set_method(connection->client, method);
+}
+
+void HttpConnectionManager::disconnect(Connection* connection) {
+    if (connection->client) {
+        esp_http_client_close(connection->client);
+    }
+
+    connection->connected = false;
+}
+
+string HttpConnectionManager::get_origin(const char* url) {
+    auto start = strstr(url, "://");
+    start = start ? start + 3 : url;
+
+    auto end = strchr(start, '/');
+
+    return end ? string(url, end - url) : string(url);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+
+struct HttpConnectionStatistics {
+    uint32_t requests;
+    uint32_t reused;
+    uint32_t connects;
+    uint32_t reconnects;
+    uint32_t failures;
+};
+
+// Keeps a keep-alive HTTP client per origin (scheme, host and port) so
+// subsequent requests to the same server skip the TCP (and TLS) handshake.
+// Requests to the same origin are serialized; requests to different origins
+// can run concurrently from different tasks.
+class HttpConnectionManager {
+    struct Connection {
+        string origin;
+        esp_http_client_handle_t client;
+        bool connected;
+        Mutex mutex;
+
+        Connection(string&& origin) : origin(move(origin)), client(nullptr), connected(false) {}
+    };
+
+    Mutex _mutex;
+    vector<Connection*> _connections;
+    std::atomic<uint32_t> _requests;
+    std::atomic<uint32_t> _reused;
+    std::atomic<uint32_t> _connects;
+    std::atomic<uint32_t> _reconnects;
+    std::atomic<uint32_t> _failures;
+
+public:
+    HttpConnectionManager();
+    HttpConnectionManager(const HttpConnectionManager&) = delete;
+    HttpConnectionManager& operator=(const HttpConnectionManager&) = delete;
+    HttpConnectionManager(HttpConnectionManager&&) = delete;
+    HttpConnectionManager& operator=(HttpConnectionManager&&) = delete;
+    ~HttpConnectionManager();
+
+    esp_err_t download_string(const esp_http_client_config_t& config, string& target, size_t maxLength = 0);
+    esp_err_t upload_string(const esp_http_client_config_t& config, const char* data, size_t length,
+                            const char* content_encoding = nullptr);
+
+    // Opens a POST request of length bytes and calls func with the client to
+    // write the body. func may be called again when a kept alive connection
+    // turned out to be closed. Fails with ESP_ERR_INVALID_RESPONSE when the
+    // server doesn't respond with a 2xx status.
+    esp_err_t post(const esp_http_client_config_t& config, size_t length, const char* content_encoding,
+                   const function<esp_err_t(esp_http_client_handle_t client)>& func);
+
+    // Opens a GET request and calls func with the client once the headers
+    // have been fetched. func reads the body; if it doesn't read the body
+    // completely, the connection is closed instead of being kept alive.
+    // range optionally is the value of a Range header.
+    esp_err_t get(const esp_http_client_config_t& config,
+                  const function<esp_err_t(esp_http_client_handle_t client, int64_t length)>& func,
+                  const char* range = nullptr);
+
+    // Reads the remainder of the response body into target.
+    static esp_err_t read_string(esp_http_client_handle_t client, string& target, size_t maxLength = 0);
+
+    HttpConnectionStatistics get_statistics() const;
+    void log_statistics() const;
+
+private:
+    Connection* get_connection(const char* url);
+    esp_err_t prepare(Connection* connection, const esp_http_client_config_t& config,
+                      esp_http_client_method_t method);
+    void disconnect(Connection* connection);
+    static string get_origin(const char* url);
+};
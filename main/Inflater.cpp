@@ -0,0 +1,72 @@
+#include "includes.h"
+
+#ifndef LV_SIMULATOR
+
+#include "Inflater.h"
+
+Inflater::Inflater(Sink sink)
+    : _sink(sink),
+      _decompressor((tinfl_decompressor *)heap_caps_malloc(sizeof(tinfl_decompressor), MALLOC_CAP_SPIRAM)),
+      _window((uint8_t *)heap_caps_malloc(WINDOW_SIZE, MALLOC_CAP_SPIRAM)),
+      _window_offset(0),
+      _status(TINFL_STATUS_NEEDS_MORE_INPUT),
+      _total_in(0),
+      _total_out(0) {
+    if (!_decompressor || !_window) {
+        abort();
+    }
+
+    tinfl_init(_decompressor);
+}
+
+Inflater::~Inflater() {
+    heap_caps_free(_decompressor);
+    heap_caps_free(_window);
+}
+
+esp_err_t Inflater::write(const uint8_t *data, size_t length) {
+    while (length > 0 || _status == TINFL_STATUS_HAS_MORE_OUTPUT) {
+        if (_status == TINFL_STATUS_DONE) {
+            // Nothing may follow the end of the stream.
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        // The window is used as a ring; the decompressor stops at its end
+        // and continues at the start on the next call.
+        auto in_size = length;
+        auto out_size = WINDOW_SIZE - _window_offset;
+
+        _status = tinfl_decompress(_decompressor, data, &in_size, _window, _window + _window_offset, &out_size,
+                                   TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+
+        data += in_size;
+        length -= in_size;
+        _total_in += in_size;
+
+        if (out_size > 0) {
+            auto err = _sink(_window + _window_offset, out_size);
+            if (err != ESP_OK) {
+                return err;
+            }
+
+            _window_offset = (_window_offset + out_size) & (WINDOW_SIZE - 1);
+            _total_out += out_size;
+        }
+
+        if (_status == TINFL_STATUS_ADLER32_MISMATCH) {
+            return ESP_ERR_INVALID_CRC;
+        }
+        if (_status < 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (_status == TINFL_STATUS_DONE && length > 0) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t Inflater::finish() { return _status == TINFL_STATUS_DONE ? ESP_OK : ESP_ERR_INVALID_SIZE; }
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#ifndef LV_SIMULATOR
+
+#include "esp32s3/rom/miniz.h"
+
+// Inflates a zlib stream while it's being received, using the decompressor
+// in ROM. Compressed data is fed in chunks of any size through write(); the
+// decompressed data is passed to the sink in order. The decompressor and
+// the 32 KB window it refers back into are allocated in PSRAM. The Adler-32
+// checksum at the end of the stream is verified.
+class Inflater {
+public:
+    using Sink = function<esp_err_t(const uint8_t *data, size_t length)>;
+
+    // First byte of a zlib stream with a 32 KB window.
+    static constexpr uint8_t ZLIB_MAGIC = 0x78;
+
+private:
+    static constexpr size_t WINDOW_SIZE = TINFL_LZ_DICT_SIZE;
+
+    Sink _sink;
+    tinfl_decompressor *_decompressor;
+    uint8_t *_window;
+    size_t _window_offset;
+    tinfl_status _status;
+    size_t _total_in;
+    size_t _total_out;
+
+public:
+    Inflater(Sink sink);
+    Inflater(const Inflater &) = delete;
+    Inflater &operator=(const Inflater &) = delete;
+    Inflater(Inflater &&) = delete;
+    Inflater &operator=(Inflater &&) = delete;
+    ~Inflater();
+
+    esp_err_t write(const uint8_t *data, size_t length);
+    // Fails when the stream was incomplete.
+    esp_err_t finish();
+
+    size_t get_total_in() const { return _total_in; }
+    size_t get_total_out() const { return _total_out; }
+};
+
+#endif
@@ -0,0 +1,63 @@
+#include "includes.h"
+
+#include "JsonDecoder.h"
+
+LOG_TAG(JsonDecoder);
+
+JsonValue JsonValue::from_cjson(const cJSON* item) {
+    JsonValue value = {};
+
+    if (cJSON_IsString(item) && item->valuestring) {
+        value.type = JsonValueType::String;
+        value.string = item->valuestring;
+    } else if (cJSON_IsNumber(item)) {
+        value.type = JsonValueType::Number;
+        value.number = item->valuedouble;
+    } else if (cJSON_IsBool(item)) {
+        value.type = JsonValueType::Bool;
+        value.boolean = cJSON_IsTrue(item);
+    } else if (cJSON_IsNull(item)) {
+        value.type = JsonValueType::Null;
+    } else {
+        value.type = JsonValueType::Other;
+    }
+
+    return value;
+}
+
+size_t JsonDecodeContext::push_key(const char* key) {
+    auto mark = _length;
+
+    auto written = snprintf(_path + _length, PATH_SIZE - _length, _length > 0 ? ".%s" : "%s", key);
+    if (written > 0) {
+        _length = min(_length + written, PATH_SIZE - 1);
+    }
+
+    return mark;
+}
+
+size_t JsonDecodeContext::push_index(int index) {
+    auto mark = _length;
+
+    auto written = snprintf(_path + _length, PATH_SIZE - _length, "[%d]", index);
+    if (written > 0) {
+        _length = min(_length + written, PATH_SIZE - 1);
+    }
+
+    return mark;
+}
+
+void JsonDecodeContext::pop(size_t mark) {
+    _length = mark;
+    _path[_length] = 0;
+}
+
+bool JsonDecodeContext::error(const char* message) {
+    ESP_LOGE(TAG, "%s: %s", _length > 0 ? _path : "(root)", message);
+    return false;
+}
+
+bool JsonDecodeContext::error(const char* message, const char* value) {
+    ESP_LOGE(TAG, "%s: %s '%s'", _length > 0 ? _path : "(root)", message, value);
+    return false;
+}
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <limits>
+#include <type_traits>
+
+#include "StringArena.h"
+
+// Table driven decoding of JSON objects into DTOs. A DTO is described by a
+// constexpr JsonFieldTable listing its fields; key lookup uses a perfect hash
+// computed at compile time. The decoder only works on JsonValue scalars, so
+// it can be fed by cJSON (see json_decode_object) or by a streaming parser
+// calling JsonFieldTable::decode_member for every member it encounters.
+
+enum class JsonValueType : uint8_t { Null, Bool, Number, String, Other };
+
+struct JsonValue {
+    JsonValueType type;
+    bool boolean;
+    double number;
+    const char* string;
+
+    static JsonValue from_cjson(const cJSON* item);
+};
+
+enum JsonFieldFlags : uint8_t {
+    JSON_REQUIRED = 0,
+    JSON_OPTIONAL = 1 << 0,
+    JSON_NULLABLE = 1 << 1,
+};
+
+// Tracks the path of the value being decoded, e.g. "last_builds[2].status",
+// so errors point at the offending value.
+class JsonDecodeContext {
+    static constexpr size_t PATH_SIZE = 96;
+
+    StringArena& _strings;
+    char _path[PATH_SIZE];
+    size_t _length;
+
+public:
+    JsonDecodeContext(StringArena& strings) : _strings(strings), _path(), _length(0) {}
+
+    StringArena& get_strings() { return _strings; }
+    const char* get_path() const { return _path; }
+
+    size_t push_key(const char* key);
+    size_t push_index(int index);
+    void pop(size_t mark);
+
+    bool error(const char* message);
+    bool error(const char* message, const char* value);
+};
+
+constexpr uint32_t json_key_hash(const char* key, uint32_t seed) {
+    // FNV-1a with the seed mixed into the offset basis.
+    uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (; *key; key++) {
+        hash = (hash ^ (uint8_t)*key) * 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+constexpr size_t json_slot_count(size_t count) {
+    size_t slots = 1;
+    while (slots < count * 2) {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+// Not constexpr on purpose: calling this while building a table at compile
+// time fails the build.
+void json_key_table_no_perfect_hash();
+
+template <size_t N>
+class JsonKeyTable {
+    static_assert(N > 0 && N <= 32, "Key tables support 1 to 32 keys");
+
+    static constexpr size_t SLOTS = json_slot_count(N);
+    static constexpr uint32_t MAX_SEED = 100000;
+
+    const char* _keys[N] = {};
+    uint32_t _seed = 0;
+    int8_t _slots[SLOTS] = {};
+
+public:
+    template <typename... K>
+    constexpr JsonKeyTable(K... keys) : _keys{keys...} {
+        while (!try_seed(_seed)) {
+            if (++_seed > MAX_SEED) {
+                json_key_table_no_perfect_hash();
+            }
+        }
+    }
+
+    int find(const char* key) const {
+        auto index = _slots[json_key_hash(key, _seed) & (SLOTS - 1)];
+        if (index >= 0 && strcmp(_keys[index], key) == 0) {
+            return index;
+        }
+        return -1;
+    }
+
+    const char* operator[](size_t index) const { return _keys[index]; }
+
+private:
+    constexpr bool try_seed(uint32_t seed) {
+        for (auto& slot : _slots) {
+            slot = -1;
+        }
+
+        for (size_t i = 0; i < N; i++) {
+            auto slot = json_key_hash(_keys[i], seed) & (SLOTS - 1);
+            if (_slots[slot] >= 0) {
+                return false;
+            }
+            _slots[slot] = int8_t(i);
+        }
+
+        return true;
+    }
+};
+
+template <typename E>
+struct JsonEnumValue {
+    const char* name;
+    E value;
+};
+
+template <typename E, size_t N>
+class JsonEnumTable {
+    E _values[N] = {};
+    JsonKeyTable<N> _keys;
+
+public:
+    template <typename... V>
+    constexpr JsonEnumTable(V... values) : _values{values.value...}, _keys(values.name...) {}
+
+    bool find(const char* name, E& value) const {
+        auto index = _keys.find(name);
+        if (index < 0) {
+            return false;
+        }
+        value = _values[index];
+        return true;
+    }
+};
+
+template <typename E, typename... V>
+JsonEnumTable(JsonEnumValue<E>, V...) -> JsonEnumTable<E, 1 + sizeof...(V)>;
+
+template <typename T>
+struct JsonField {
+    const char* name = nullptr;
+    uint8_t flags = JSON_REQUIRED;
+    bool (*set)(T& target, const JsonValue& value, JsonDecodeContext& context) = nullptr;
+};
+
+template <typename T, size_t N>
+class JsonFieldTable {
+    JsonField<T> _fields[N] = {};
+    JsonKeyTable<N> _keys;
+
+public:
+    template <typename... F>
+    constexpr JsonFieldTable(F... fields) : _fields{fields...}, _keys(fields.name...) {}
+
+    // Decodes a single member. Unknown members are ignored. seen collects
+    // the decoded fields for check_required.
+    bool decode_member(T& target, const char* key, const JsonValue& value, JsonDecodeContext& context,
+                       uint32_t& seen) const {
+        auto index = _keys.find(key);
+        if (index < 0) {
+            return true;
+        }
+
+        auto& field = _fields[index];
+
+        auto mark = context.push_key(key);
+
+        if (value.type == JsonValueType::Null && (field.flags & JSON_NULLABLE)) {
+            // Null leaves the value initialized member alone.
+        } else if (!field.set(target, value, context)) {
+            return false;
+        }
+
+        context.pop(mark);
+
+        seen |= 1u << index;
+
+        return true;
+    }
+
+    bool check_required(uint32_t seen, JsonDecodeContext& context) const {
+        for (size_t i = 0; i < N; i++) {
+            if (!(seen & (1u << i)) && !(_fields[i].flags & JSON_OPTIONAL)) {
+                return context.error("missing required field", _fields[i].name);
+            }
+        }
+        return true;
+    }
+};
+
+template <typename T, typename... F>
+JsonFieldTable(JsonField<T>, F...) -> JsonFieldTable<T, 1 + sizeof...(F)>;
+
+template <typename M>
+struct json_member_traits;
+
+template <typename C, typename M>
+struct json_member_traits<M C::*> {
+    using class_type = C;
+    using member_type = M;
+};
+
+template <typename M>
+bool json_assign(M& target, const JsonValue& value, JsonDecodeContext& context) {
+    if constexpr (std::is_same<M, const char*>::value) {
+        if (value.type != JsonValueType::String) {
+            return context.error("expected a string");
+        }
+        target = context.get_strings().intern(value.string);
+    } else if constexpr (std::is_same<M, bool>::value) {
+        if (value.type != JsonValueType::Bool) {
+            return context.error("expected a boolean");
+        }
+        target = value.boolean;
+    } else {
+        static_assert(std::is_integral<M>::value, "Unsupported JSON field type");
+
+        if (value.type != JsonValueType::Number) {
+            return context.error("expected a number");
+        }
+
+        // Saturate like cJSON does for valueint.
+        if (value.number >= (double)std::numeric_limits<M>::max()) {
+            target = std::numeric_limits<M>::max();
+        } else if (value.number <= (double)std::numeric_limits<M>::min()) {
+            target = std::numeric_limits<M>::min();
+        } else {
+            target = static_cast<M>(value.number);
+        }
+    }
+
+    return true;
+}
+
+template <auto Member>
+bool json_set(typename json_member_traits<decltype(Member)>::class_type& target, const JsonValue& value,
+              JsonDecodeContext& context) {
+    return json_assign(target.*Member, value, context);
+}
+
+// Sets HasValue to true when the member was present and not null.
+template <auto Member, auto HasValue>
+bool json_set_nullable(typename json_member_traits<decltype(Member)>::class_type& target, const JsonValue& value,
+                       JsonDecodeContext& context) {
+    if (!json_assign(target.*Member, value, context)) {
+        return false;
+    }
+    target.*HasValue = true;
+    return true;
+}
+
+template <auto Member, const auto* Enum>
+bool json_set_enum(typename json_member_traits<decltype(Member)>::class_type& target, const JsonValue& value,
+                   JsonDecodeContext& context) {
+    if (value.type != JsonValueType::String) {
+        return context.error("expected a string");
+    }
+    if (!Enum->find(value.string, target.*Member)) {
+        return context.error("unknown value", value.string);
+    }
+    return true;
+}
+
+template <auto Member>
+constexpr auto json_field(const char* name, uint8_t flags = JSON_REQUIRED) {
+    return JsonField<typename json_member_traits<decltype(Member)>::class_type>{name, flags, json_set<Member>};
+}
+
+template <auto Member, auto HasValue>
+constexpr auto json_nullable_field(const char* name, uint8_t flags = JSON_NULLABLE) {
+    return JsonField<typename json_member_traits<decltype(Member)>::class_type>{
+        name, uint8_t(flags | JSON_NULLABLE), json_set_nullable<Member, HasValue>};
+}
+
+template <auto Member, const auto* Enum>
+constexpr auto json_enum_field(const char* name, uint8_t flags = JSON_REQUIRED) {
+    return JsonField<typename json_member_traits<decltype(Member)>::class_type>{name, flags,
+                                                                                json_set_enum<Member, Enum>};
+}
+
+// Decodes a cJSON object in a single pass over its members.
+template <typename T, size_t N>
+bool json_decode_object(const cJSON* item, const JsonFieldTable<T, N>& fields, T& target,
+                        JsonDecodeContext& context) {
+    if (!cJSON_IsObject(item)) {
+        return context.error("expected an object");
+    }
+
+    uint32_t seen = 0;
+    cJSON* member;
+    cJSON_ArrayForEach(member, item) {
+        if (!fields.decode_member(target, member->string, JsonValue::from_cjson(member), context, seen)) {
+            return false;
+        }
+    }
+
+    return fields.check_required(seen, context);
+}
+
+// Decodes a cJSON array of objects, appending them to target.
+template <typename T, size_t N>
+bool json_decode_array(const cJSON* item, const JsonFieldTable<T, N>& fields, vector<T>& target,
+                       JsonDecodeContext& context) {
+    if (!cJSON_IsArray(item)) {
+        return context.error("expected an array");
+    }
+
+    auto index = 0;
+    cJSON* element;
+    cJSON_ArrayForEach(element, item) {
+        auto mark = context.push_index(index++);
+
+        T dto{};
+        if (!json_decode_object(element, fields, dto, context)) {
+            return false;
+        }
+        target.push_back(dto);
+
+        context.pop(mark);
+    }
+
+    return true;
+}
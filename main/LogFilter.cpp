@@ -0,0 +1,115 @@
+#include "includes.h"
+
+#ifndef LV_SIMULATOR
+
+#include "LogFilter.h"
+
+LOG_TAG(LogFilter);
+
+void LogFilter::configure(const vector<LogFilterConfiguration>& filters) {
+    auto count = 0;
+
+    for (const auto& filter : filters) {
+        if (filter.level >= 0) {
+            esp_log_level_set(filter.tag.c_str(), (esp_log_level_t)filter.level);
+        }
+
+        if (filter.rate <= 0) {
+            continue;
+        }
+        if (count == MAX_BUCKETS) {
+            ESP_LOGW(TAG, "Too many rate limited tags, ignoring %s", filter.tag.c_str());
+            continue;
+        }
+
+        if (filter.tag == "*") {
+            _fallback = count;
+        }
+
+        auto& bucket = _buckets[count++];
+
+        bucket.tag = filter.tag.c_str();
+        bucket.interval = (int64_t)(1000000 / filter.rate);
+        bucket.tolerance = bucket.interval * filter.burst;
+        bucket.full_at = 0;
+        bucket.suppressed = 0;
+    }
+
+    _bucket_count.store(count, std::memory_order_release);
+}
+
+bool LogFilter::allow(const char* format, va_list va) {
+    const auto count = _bucket_count.load(std::memory_order_acquire);
+    if (!count) {
+        return true;
+    }
+
+    const auto tag = get_tag(format, va);
+    if (!tag) {
+        return true;
+    }
+
+    for (auto i = 0; i < count; i++) {
+        if (strcmp(_buckets[i].tag, tag) == 0) {
+            return take(_buckets[i]);
+        }
+    }
+
+    if (_fallback >= 0) {
+        return take(_buckets[_fallback]);
+    }
+
+    return true;
+}
+
+bool LogFilter::take(Bucket& bucket) {
+    const auto now = esp_timer_get_time();
+    auto full_at = bucket.full_at.load(std::memory_order_relaxed);
+
+    while (true) {
+        const auto next = max(full_at, now) + bucket.interval;
+        if (next - now > bucket.tolerance) {
+            bucket.suppressed++;
+            return false;
+        }
+
+        if (bucket.full_at.compare_exchange_weak(full_at, next, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+const char* LogFilter::get_tag(const char* format, va_list va) {
+    // ESP_LOGx formats start with an optional color, the level letter, the
+    // timestamp and the tag: "\033[0;32mI (%lu) %s: ...".
+    auto p = format;
+    if (*p == '\033') {
+        p = strchr(p, 'm');
+        if (!p) {
+            return nullptr;
+        }
+        p++;
+    }
+
+    if (!*p || !strchr("EWIDV", *p) || strncmp(p + 1, " (%", 3) != 0) {
+        return nullptr;
+    }
+
+    p = strchr(p, ')');
+    if (!p || strncmp(p, ") %s: ", 6) != 0) {
+        return nullptr;
+    }
+
+    va_list vaCopy;
+    va_copy(vaCopy, va);
+
+    // The timestamp is either a 32-bit number or a string.
+    va_arg(vaCopy, uint32_t);
+    auto tag = va_arg(vaCopy, const char*);
+
+    va_end(vaCopy);
+
+    return tag;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef LV_SIMULATOR
+
+#include <atomic>
+
+#include "DeviceConfiguration.h"
+
+// Per tag log levels and rate limits from the device configuration. Levels
+// are handed to esp_log_level_set, so filtered messages never reach the log
+// handler. Rate limits are checked in the log handler before anything is
+// formatted.
+//
+// Every rate limited tag has a token bucket, implemented as the time at
+// which the bucket is full again. Taking a token moves that time forward by
+// the interval between messages, and a message is suppressed when that
+// would exceed a full burst. That's a single atomic value, so the log
+// handler doesn't need to lock. A "*" rate limit is a single bucket shared
+// by all tags without a rate limit of their own.
+class LogFilter {
+    static constexpr int MAX_BUCKETS = 16;
+
+    struct Bucket {
+        const char* tag;
+        int64_t interval;
+        int64_t tolerance;
+        std::atomic<int64_t> full_at;
+        std::atomic<uint32_t> suppressed;
+    };
+
+    Bucket _buckets[MAX_BUCKETS];
+    std::atomic<int> _bucket_count;
+    int _fallback;
+
+public:
+    LogFilter() : _bucket_count(0), _fallback(-1) {}
+    LogFilter(const LogFilter&) = delete;
+    LogFilter& operator=(const LogFilter&) = delete;
+    LogFilter(LogFilter&&) = delete;
+    LogFilter& operator=(LogFilter&&) = delete;
+
+    // Must be called once; the configuration must outlive the filter.
+    void configure(const vector<LogFilterConfiguration>& filters);
+
+    // Takes the log handler arguments and returns whether the message
+    // passes the rate limit of its tag.
+    bool allow(const char* format, va_list va);
+
+    int get_bucket_count() const { return _bucket_count.load(std::memory_order_acquire); }
+    const char* get_tag(int index) const { return _buckets[index].tag; }
+    uint32_t take_suppressed(int index) { return _buckets[index].suppressed.exchange(0); }
+
+private:
+    static bool take(Bucket& bucket);
+    static const char* get_tag(const char* format, va_list va);
+};
+
+#endif
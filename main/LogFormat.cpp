@@ -0,0 +1,360 @@
+#include "includes.h"
+
+#include "LogFormat.h"
+
+template <typename T>
+static void write_value(uint8_t* target, int& offset, T value) {
+    if (target) {
+        memcpy(target + offset, &value, sizeof(value));
+    }
+    offset += sizeof(value);
+}
+
+template <typename T>
+static bool read_value(const uint8_t* args, size_t length, size_t& offset, T& value) {
+    if (offset + sizeof(value) > length) {
+        return false;
+    }
+    memcpy(&value, args + offset, sizeof(value));
+    offset += sizeof(value);
+    return true;
+}
+
+void LogFormat::capture(const char* format, va_list va, uint8_t* target, size_t length, size_t string_length) {
+    const auto written = (size_t)serialize(format, va, target, string_length);
+
+    memset(target + written, 0, length - written);
+}
+
+int LogFormat::serialize(const char* format, va_list va, uint8_t* target, size_t& string_length) {
+    va_list args;
+    va_copy(args, va);
+
+    auto offset = 0;
+
+    for (auto p = format; *p;) {
+        if (*p != '%') {
+            p++;
+            continue;
+        }
+
+        Spec spec;
+        parse(p, spec);
+
+        if (spec.type == ArgType::Unsupported) {
+            offset = -1;
+            break;
+        }
+        if (spec.type == ArgType::None) {
+            continue;
+        }
+
+        auto precision = spec.precision;
+
+        if (spec.width_arg) {
+            write_value(target, offset, (int32_t)va_arg(args, int));
+        }
+        if (spec.precision_arg) {
+            precision = va_arg(args, int);
+            write_value(target, offset, (int32_t)precision);
+        }
+
+        switch (spec.type) {
+            case ArgType::Int32:
+                write_value(target, offset, (int32_t)va_arg(args, int));
+                break;
+
+            case ArgType::Int64:
+                write_value(target, offset, (int64_t)va_arg(args, long long));
+                break;
+
+            case ArgType::Double:
+                write_value(target, offset, va_arg(args, double));
+                break;
+
+            case ArgType::Pointer:
+                write_value(target, offset, (uintptr_t)va_arg(args, void*));
+                break;
+
+            case ArgType::String: {
+                auto value = va_arg(args, const char*);
+                if (!value) {
+                    value = "(null)";
+                }
+
+                // Only copy what a precision would print.
+                auto length = precision >= 0 ? strnlen(value, precision) : strlen(value);
+                length = min(length, (size_t)UINT16_MAX);
+
+                if (target) {
+                    // Measuring adds up the string lengths; capturing takes
+                    // them out of what was measured.
+                    length = min(length, string_length);
+                    string_length -= length;
+                } else {
+                    string_length += length;
+                }
+
+                write_value(target, offset, (uint16_t)length);
+                if (target) {
+                    memcpy(target + offset, value, length);
+                }
+                offset += length;
+                break;
+            }
+        }
+    }
+
+    va_end(args);
+
+    return offset;
+}
+
+int LogFormat::render(const char* format, const uint8_t* args, size_t length, char* target, size_t size) {
+    size_t offset = 0;
+    size_t written = 0;
+
+    auto append = [&](const char* value, size_t value_length) {
+        if (written < size) {
+            memcpy(target + written, value, min(value_length, size - written));
+        }
+        written += value_length;
+    };
+
+    for (auto p = format; *p;) {
+        if (*p != '%') {
+            auto end = strchr(p, '%');
+            if (!end) {
+                end = p + strlen(p);
+            }
+            append(p, end - p);
+            p = end;
+            continue;
+        }
+
+        Spec spec;
+        parse(p, spec);
+
+        if (spec.type == ArgType::Unsupported) {
+            return -1;
+        }
+        if (spec.type == ArgType::None) {
+            append("%", 1);
+            continue;
+        }
+
+        int32_t width = 0;
+        int32_t precision = spec.precision;
+        if ((spec.width_arg && !read_value(args, length, offset, width)) ||
+            (spec.precision_arg && !read_value(args, length, offset, precision))) {
+            return -1;
+        }
+
+        // Rebuild the conversion with the * arguments filled in and the
+        // length modifiers matching the stored argument.
+        char conversion[48];
+        size_t conversion_length = 0;
+        auto stars = 0;
+
+        for (auto c = spec.start; c < spec.end - 1 && conversion_length < sizeof(conversion) - 16; c++) {
+            if (*c == '*') {
+                conversion_length += snprintf(conversion + conversion_length, sizeof(conversion) - conversion_length,
+                                              "%d", (int)(stars++ == 0 && spec.width_arg ? width : precision));
+            } else if (!strchr("ljztqL", *c)) {
+                conversion[conversion_length++] = *c;
+            }
+        }
+        if (spec.type == ArgType::Int64) {
+            conversion[conversion_length++] = 'l';
+            conversion[conversion_length++] = 'l';
+        }
+        conversion[conversion_length++] = spec.end[-1];
+        conversion[conversion_length] = 0;
+
+        auto out = written < size ? target + written : nullptr;
+        auto available = written < size ? size - written : 0;
+        auto result = 0;
+
+        switch (spec.type) {
+            case ArgType::Int32: {
+                int32_t value;
+                if (!read_value(args, length, offset, value)) {
+                    return -1;
+                }
+                result = snprintf(out, available, conversion, (int)value);
+                break;
+            }
+
+            case ArgType::Int64: {
+                int64_t value;
+                if (!read_value(args, length, offset, value)) {
+                    return -1;
+                }
+                result = snprintf(out, available, conversion, (long long)value);
+                break;
+            }
+
+            case ArgType::Double: {
+                double value;
+                if (!read_value(args, length, offset, value)) {
+                    return -1;
+                }
+                result = snprintf(out, available, conversion, value);
+                break;
+            }
+
+            case ArgType::Pointer: {
+                uintptr_t value;
+                if (!read_value(args, length, offset, value)) {
+                    return -1;
+                }
+                result = snprintf(out, available, conversion, (void*)value);
+                break;
+            }
+
+            case ArgType::String: {
+                uint16_t value_length;
+                if (!read_value(args, length, offset, value_length) || offset + value_length > length) {
+                    return -1;
+                }
+
+                // The copy isn't terminated; limit the precision to it.
+                auto dot = strchr(conversion, '.');
+                auto prefix_length = (int)(dot ? dot - conversion : conversion_length - 1);
+                auto string_precision = precision >= 0 ? min((int)value_length, (int)precision) : (int)value_length;
+
+                char string_conversion[64];
+                snprintf(string_conversion, sizeof(string_conversion), "%.*s.%ds", prefix_length, conversion,
+                         string_precision);
+
+                result = snprintf(out, available, string_conversion, (const char*)args + offset);
+                offset += value_length;
+                break;
+            }
+        }
+
+        if (result < 0) {
+            return -1;
+        }
+        written += result;
+    }
+
+    if (size > 0) {
+        target[min(written, size - 1)] = 0;
+    }
+
+    return (int)written;
+}
+
+void LogFormat::parse(const char*& p, Spec& spec) {
+    spec.start = p++;
+    spec.width_arg = false;
+    spec.precision_arg = false;
+    spec.precision = -1;
+
+    if (*p == '%') {
+        spec.end = ++p;
+        spec.type = ArgType::None;
+        return;
+    }
+
+    while (*p && strchr("-+ #0", *p)) {
+        p++;
+    }
+
+    if (*p == '*') {
+        spec.width_arg = true;
+        p++;
+    } else {
+        while (isdigit((uint8_t)*p)) {
+            p++;
+        }
+    }
+
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec.precision_arg = true;
+            p++;
+        } else {
+            spec.precision = 0;
+            while (isdigit((uint8_t)*p)) {
+                spec.precision = spec.precision * 10 + (*p++ - '0');
+            }
+        }
+    }
+
+    size_t size = sizeof(int);
+    auto is_long = false;
+    auto is_long_double = false;
+
+    if (*p == 'h') {
+        p += p[1] == 'h' ? 2 : 1;
+    } else if (*p == 'l' && p[1] == 'l') {
+        size = sizeof(long long);
+        p += 2;
+    } else if (*p == 'l') {
+        size = sizeof(long);
+        is_long = true;
+        p++;
+    } else if (*p == 'j' || *p == 'q') {
+        size = sizeof(int64_t);
+        p++;
+    } else if (*p == 'z') {
+        size = sizeof(size_t);
+        p++;
+    } else if (*p == 't') {
+        size = sizeof(ptrdiff_t);
+        p++;
+    } else if (*p == 'L') {
+        is_long_double = true;
+        p++;
+    }
+
+    if (!*p) {
+        spec.end = p;
+        spec.type = ArgType::Unsupported;
+        return;
+    }
+
+    switch (*p++) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            spec.type = size > sizeof(int32_t) ? ArgType::Int64 : ArgType::Int32;
+            break;
+
+        case 'c':
+            spec.type = is_long ? ArgType::Unsupported : ArgType::Int32;
+            break;
+
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec.type = is_long_double ? ArgType::Unsupported : ArgType::Double;
+            break;
+
+        case 'p':
+            spec.type = ArgType::Pointer;
+            break;
+
+        case 's':
+            spec.type = is_long ? ArgType::Unsupported : ArgType::String;
+            break;
+
+        default:
+            // Includes %n, which must never be deferred.
+            spec.type = ArgType::Unsupported;
+            break;
+    }
+
+    spec.end = p;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Deferred printf style formatting. capture() stores the arguments of a
+// format string in a compact binary form, copying strings; render()
+// formats them later. Only conversions whose argument type is known are
+// supported; measure() returns -1 for anything else (e.g. %n, long double
+// or wide characters), in which case the message has to be formatted right
+// away.
+//
+// The binary form stores 32-bit and 64-bit integers and doubles unaligned in
+// native byte order, and strings as a 16-bit length followed by the bytes.
+class LogFormat {
+    enum class ArgType { None, Int32, Int64, Double, Pointer, String, Unsupported };
+
+    struct Spec {
+        const char* start;
+        const char* end;
+        bool width_arg;
+        bool precision_arg;
+        int precision;
+        ArgType type;
+    };
+
+public:
+    // Returns the number of bytes capture() writes, or -1 when the format
+    // string can't be deferred. string_length receives the bytes taken by
+    // string arguments.
+    static int measure(const char* format, va_list va, size_t& string_length) {
+        string_length = 0;
+        return serialize(format, va, nullptr, string_length);
+    }
+
+    // Writes exactly length bytes, as returned by measure(). Strings may
+    // have changed since they were measured, so they are cut off once they
+    // exceed string_length together; any space left is zeroed.
+    static void capture(const char* format, va_list va, uint8_t* target, size_t length, size_t string_length);
+
+    // Formats captured arguments like vsnprintf would. Returns the length of
+    // the result without truncation, or -1 when the arguments are corrupt.
+    static int render(const char* format, const uint8_t* args, size_t length, char* target, size_t size);
+
+private:
+    static int serialize(const char* format, va_list va, uint8_t* target, size_t& string_length);
+    static void parse(const char*& p, Spec& spec);
+};
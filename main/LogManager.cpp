@@ -2,131 +2,485 @@
 
 #include "LogManager.h"
 
+#include "LogFormat.h"
+#include "NdjsonWriter.h"
+#include "esp_memory_utils.h"
+
 constexpr auto BUFFER_SIZE = 1024;
-constexpr auto BLOCK_SIZE = 10;
+constexpr auto UPLOAD_TASK_STACK_SIZE = 8192;
+constexpr auto UPLOAD_TASK_PRIORITY = 1;
+
+// A record starts with the capture time and the record type. Text records
+// continue with the terminated message, deferred records with the format
+// string pointer and the arguments captured by LogFormat.
+constexpr auto RECORD_HEADER_SIZE = sizeof(uint32_t) + 1;
+
+// Batches are uploaded as gzip compressed NDJSON with Content-Encoding: gzip.
+// The first line is a header with the fields shared by all lines:
+//
+//   entity_id      The device entity.
+//   uptime         Milliseconds since boot when the batch was built.
+//   previous_boot  Whether the lines come from the spool of an earlier boot.
+//   batches, bytes, compressed_bytes, upload_ms
+//                  Totals of the batches uploaded before this one since
+//                  boot, for the compression ratio and upload time.
+//
+// The other lines hold a message and either relative_time, the age of the
+// message in milliseconds at the uptime of the header, or for an earlier
+// boot, uptime, the milliseconds since that boot.
 
 static const char* TAG = "LogManager";
 
 LogManager* LogManager::_instance = nullptr;
 char* LogManager::_buffer = new char[BUFFER_SIZE];
+char* LogManager::_message_buffer = new char[BUFFER_SIZE];
 
 int LogManager::log_handler(const char* message, va_list va) {
+    if (!_instance->_filter.allow(message, va)) {
+        // Get the suppressed count reported.
+        if (!_instance->_upload_requested.exchange(true)) {
+            xTaskNotifyGive(_instance->_upload_task);
+        }
+        return 0;
+    }
+
     va_list vaCopy;
     va_copy(vaCopy, va);
 
-    _instance->_default_log_handler(message, vaCopy);
+    auto result = _instance->_default_log_handler(message, vaCopy);
 
     va_end(vaCopy);
 
-    return _instance->_mutex.with<int>([message, va]() {
-        auto result = vsnprintf(_buffer, BUFFER_SIZE, message, va);
+    _instance->capture(message, va);
 
-        bool startTimer = false;
+    return result;
+}
+
+LogManager::LogManager(HttpConnectionManager* http_connection_manager)
+    : _http_connection_manager(http_connection_manager),
+      _default_log_handler(nullptr),
+      _ring(CONFIG_LOG_BUFFER_SIZE,
+#ifdef CONFIG_LOG_BUFFER_OVERWRITE_OLDEST
+            LogRingPolicy::OverwriteOldest
+#else
+            LogRingPolicy::DropNewest
+#endif
+            ),
+      _configuration(nullptr),
+      _upload_task(nullptr),
+      _upload_requested(false),
+      _flush_requested(false),
+      _reported_dropped(0),
+      _batch_pending(false),
+      _batch_position(0),
+      _uploaded_batches(0),
+      _uploaded_bytes(0),
+      _compressed_bytes(0),
+      _upload_ms(0) {
+    _instance = this;
+
+    // Room for a full batch plus the message that pushes it over the size.
+    _upload_buffer.reserve(CONFIG_LOG_BATCH_SIZE + BUFFER_SIZE * 2);
+    _compressed_buffer.reserve(GzipEncoder::get_max_size(_upload_buffer.capacity()));
+}
 
-        if (result >= 0 && result < BUFFER_SIZE) {
-            startTimer = _instance->_configuration && _instance->_messages.size() == 0;
+void LogManager::capture(const char* message, va_list va) {
+    const uint32_t time = esp_get_millis();
+    LogRing::Reservation reservation = {};
+
+#ifdef CONFIG_LOG_DEFERRED_FORMAT
+    // Format strings in flash outlive the record, so only the arguments
+    // need to be stored.
+    if (esp_ptr_in_drom(message)) {
+        size_t string_length;
+        auto args_length = LogFormat::measure(message, va, string_length);
+        auto record_length = RECORD_HEADER_SIZE + sizeof(message) + args_length;
+
+        if (args_length >= 0 && record_length <= BUFFER_SIZE) {
+            reservation = _ring.reserve(record_length);
+            if (!reservation) {
+                return;
+            }
 
-            _instance->_messages.push_back(Message(strdup(_buffer), esp_get_millis()));
+            reservation.data[sizeof(time)] = (uint8_t)RecordType::Deferred;
+            memcpy(reservation.data + RECORD_HEADER_SIZE, &message, sizeof(message));
+            LogFormat::capture(message, va, reservation.data + RECORD_HEADER_SIZE + sizeof(message), args_length,
+                               string_length);
         }
+    }
+#endif
+
+    if (!reservation) {
+        // Measure first so the message can be formatted straight into the
+        // ring.
+        va_list vaCopy;
+        va_copy(vaCopy, va);
+
+        auto length = vsnprintf(nullptr, 0, message, vaCopy);
+
+        va_end(vaCopy);
 
-        if (startTimer) {
-            _instance->start_timer();
+        const auto record_length = RECORD_HEADER_SIZE + length + 1;
+        if (length < 0 || record_length > BUFFER_SIZE) {
+            return;
         }
 
-        return result;
-    });
-}
+        reservation = _ring.reserve(record_length);
+        if (!reservation) {
+            return;
+        }
 
-LogManager::LogManager() : _default_log_handler(nullptr), _configuration(nullptr) { _instance = this; }
+        reservation.data[sizeof(time)] = (uint8_t)RecordType::Text;
+        vsnprintf((char*)reservation.data + RECORD_HEADER_SIZE, length + 1, message, va);
+    }
+
+    memcpy(reservation.data, &time, sizeof(time));
+
+    _ring.commit(reservation);
+
+    if (!_configuration) {
+        return;
+    }
+
+    if (!_upload_requested.exchange(true)) {
+        xTaskNotifyGive(_upload_task);
+    } else if (_ring.get_used() >= _ring.get_capacity() / 2 && !_flush_requested.exchange(true)) {
+        // Don't wait for the interval to pass when the ring is filling up.
+        xTaskNotifyGive(_upload_task);
+    }
+}
 
 void LogManager::begin() {
-    _default_log_handler = esp_log_set_vprintf(log_handler);
+    _spool.begin();
 
-    const esp_timer_create_args_t displayOffTimerArgs = {
-        .callback = [](void* arg) { ((LogManager*)arg)->uploadLogs(); },
-        .arg = this,
-        .name = "logManagerTimer",
-    };
+    xTaskCreate([](void* arg) { ((LogManager*)arg)->upload_task(); }, "logUpload", UPLOAD_TASK_STACK_SIZE, this,
+                UPLOAD_TASK_PRIORITY, &_upload_task);
 
-    ESP_ERROR_CHECK(esp_timer_create(&displayOffTimerArgs, &_log_timer));
+    _default_log_handler = esp_log_set_vprintf(log_handler);
 
+    // Uploading here could hold up the restart for the full receive timeout.
+    // Messages on flash are uploaded after the restart instead.
     esp_register_shutdown_handler([]() {
         if (_instance) {
-            ESP_LOGI(TAG, "Uploading log messages before restart");
+            auto lock = _instance->_mutex.take();
 
-            _instance->uploadLogs();
+            _instance->spool_ring();
         }
     });
 }
 
 void LogManager::set_configuration(const DeviceConfiguration& configuration) {
-    auto startTimer = _mutex.with<bool>([this, &configuration]() {
-        _configuration = &configuration;
+    _filter.configure(configuration.get_log_filters());
 
-        return _messages.size() > 0;
-    });
+    _configuration = &configuration;
 
-    if (startTimer) {
-        this->start_timer();
+    // Messages may have been captured or recovered from the spool before
+    // there was a configuration.
+    if (!_upload_requested.exchange(true)) {
+        xTaskNotifyGive(_upload_task);
     }
 }
 
-void LogManager::uploadLogs() {
-    auto messages = _mutex.with<vector<Message>>([this]() {
-        if (!_configuration) {
-            return vector<Message>();
+void LogManager::upload_task() {
+    uint32_t retry_delay = 0;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Collect messages for an interval, unless the ring is filling up
+        // or this is a retry.
+        if (!_flush_requested) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_LOG_INTERVAL));
         }
 
-        auto messages = _messages;
+        // Messages captured from here on request the next upload.
+        _upload_requested = false;
+        _flush_requested = false;
 
-        _messages.clear();
+        if (uploadLogs()) {
+            retry_delay = 0;
+        } else {
+            // Back off with jitter. Keeping the flush request set stops
+            // capture from waking us up early; when the ring fills up in the
+            // meantime, it drops messages according to its policy.
+            _flush_requested = true;
 
-        return messages;
-    });
+            retry_delay = retry_delay ? min(retry_delay * 2, (uint32_t)CONFIG_LOG_RETRY_MAX_INTERVAL)
+                                      : (uint32_t)CONFIG_LOG_INTERVAL;
 
-    string buffer;
-    auto offset = 0;
+            vTaskDelay(pdMS_TO_TICKS(retry_delay / 2 + esp_random() % (retry_delay / 2 + 1)));
+        }
+
+        if ((_batch_pending || !_ring.empty()) && !_upload_requested.exchange(true)) {
+            xTaskNotifyGive(_upload_task);
+        }
+    }
+}
+
+LogUploadStatistics LogManager::get_statistics() const {
+    return {
+        .batches = _uploaded_batches,
+        .bytes = _uploaded_bytes,
+        .compressed_bytes = _compressed_bytes,
+        .upload_ms = _upload_ms,
+    };
+}
+
+bool LogManager::uploadLogs() {
+    const auto configuration = _configuration.load();
+    if (!configuration) {
+        return true;
+    }
+
+    if (_spool.get_recovered_count() && !upload_recovered()) {
+        return false;
+    }
+
+    auto& buffer = _upload_buffer;
+
+    if (_batch_pending) {
+        if (!upload(buffer)) {
+            return false;
+        }
 
-    while (offset < messages.size()) {
+        _batch_pending = false;
+
+        auto lock = _mutex.take();
+        _spool.acknowledge(_batch_position);
+    }
+
+    auto done = false;
+
+    while (!done) {
         buffer.clear();
 
         auto millis = esp_get_millis();
+        uint64_t spool_position = 0;
+
+        append_header(buffer, millis, false);
+        const auto header_length = buffer.length();
+
+        {
+            auto lock = _mutex.take();
+
+            const auto dropped = _ring.get_dropped();
+            if (dropped != _reported_dropped) {
+                snprintf(_message_buffer, BUFFER_SIZE,
+                         "Dropped %" PRIu32 " log messages because the buffer was full", dropped - _reported_dropped);
+                _reported_dropped = dropped;
+
+                append_message(buffer, _message_buffer, 0);
+            }
+
+            for (auto i = 0; i < _filter.get_bucket_count(); i++) {
+                const auto suppressed = _filter.take_suppressed(i);
+                if (suppressed) {
+                    snprintf(_message_buffer, BUFFER_SIZE,
+                             "Suppressed %" PRIu32 " log messages of tag %s by its rate limit", suppressed,
+                             _filter.get_tag(i));
+
+                    append_message(buffer, _message_buffer, 0);
+                }
+            }
+
+            while (buffer.length() < CONFIG_LOG_BATCH_SIZE) {
+                uint32_t time;
+                auto message = read_message(time);
+                if (!message) {
+                    done = true;
+                    break;
+                }
+
+                spool_position = _spool.append(time, message);
 
-        for (auto i = 0; i < BLOCK_SIZE; i++) {
-            auto index = offset++;
-            if (index >= messages.size()) {
-                break;
+                append_message(buffer, message, millis - time);
             }
 
-            auto message = messages[index];
+            // Get the batch on flash before it leaves the device, so it
+            // survives a reset during the upload.
+            _spool.flush();
+        }
+
+        if (buffer.length() == header_length) {
+            break;
+        }
+
+        if (!upload(buffer)) {
+            _batch_pending = true;
+            _batch_position = spool_position;
+            return false;
+        }
+
+        auto lock = _mutex.take();
+        _spool.acknowledge(spool_position);
+    }
+
+    return true;
+}
+
+bool LogManager::upload_recovered() {
+    auto& buffer = _upload_buffer;
+    buffer.clear();
+
+    {
+        auto lock = _mutex.take();
+
+        snprintf(_message_buffer, BUFFER_SIZE, "Uploading %d log messages from before the last reset (%s)",
+                 (int)_spool.get_recovered_count(), esp_reset_reason_to_name(esp_reset_reason()));
+
+        append_header(buffer, esp_get_millis(), false);
+        append_message(buffer, _message_buffer, 0);
+    }
+
+    if (!upload(buffer)) {
+        return false;
+    }
+
+    auto more = true;
 
-            auto root = cJSON_CreateObject();
+    while (more) {
+        uint64_t position = 0;
+
+        buffer.clear();
 
-            cJSON_AddStringToObject(root, "message", message.buffer);
-            cJSON_AddNumberToObject(root, "relative_time", millis - message.time);
-            cJSON_AddStringToObject(root, "entity_id", _configuration->get_device_entity_id().c_str());
+        append_header(buffer, esp_get_millis(), true);
+        const auto header_length = buffer.length();
 
-            auto json = cJSON_PrintUnformatted(root);
-            cJSON_Delete(root);
+        {
+            auto lock = _mutex.take();
 
-            buffer.append(json);
-            buffer.append("\n");
+            while (buffer.length() < CONFIG_LOG_BATCH_SIZE) {
+                uint32_t time;
+                if (!_spool.read_recovered(time, _message_buffer, BUFFER_SIZE, position)) {
+                    more = false;
+                    break;
+                }
 
-            cJSON_free(json);
+                append_recovered_message(buffer, _message_buffer, time);
+            }
+        }
 
-            free(message.buffer);
+        if (buffer.length() == header_length) {
+            break;
         }
 
-        esp_http_client_config_t config = {
-            .url = CONFIG_LOG_ENDPOINT,
-            .timeout_ms = CONFIG_LOG_RECV_TIMEOUT,
-        };
+        const auto uploaded = upload(buffer);
 
-        auto err = esp_http_upload_string(config, buffer.c_str());
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to upload log: %d", err);
+        auto lock = _mutex.take();
+
+        if (!uploaded) {
+            _spool.rewind_recovered();
+            return false;
         }
+
+        _spool.acknowledge(position);
     }
+
+    auto lock = _mutex.take();
+    _spool.finish_recovered();
+
+    return true;
 }
 
-void LogManager::start_timer() { ESP_ERROR_CHECK(esp_timer_start_once(_log_timer, ESP_TIMER_MS(CONFIG_LOG_INTERVAL))); }
+bool LogManager::upload(const string& buffer) {
+    esp_http_client_config_t config = {
+        .url = CONFIG_LOG_ENDPOINT,
+        .timeout_ms = CONFIG_LOG_RECV_TIMEOUT,
+    };
+
+    _compressed_buffer.clear();
+    _gzip.encode(buffer.c_str(), buffer.length(), _compressed_buffer);
+
+    const auto start = esp_timer_get_time();
+
+    // All batches go to the same origin and so share a single kept alive
+    // connection.
+    auto err = _http_connection_manager->upload_string(config, _compressed_buffer.c_str(),
+                                                       _compressed_buffer.length(), "gzip");
+    if (err != ESP_OK) {
+        // Includes batches the server rejected with a non-2xx status. The
+        // batch is kept and sent again after backing off.
+        ESP_LOGE(TAG, "Failed to upload log: %d", err);
+        return false;
+    }
+
+    _uploaded_batches++;
+    _uploaded_bytes += buffer.length();
+    _compressed_bytes += _compressed_buffer.length();
+    _upload_ms += (uint32_t)((esp_timer_get_time() - start) / 1000);
+
+    return true;
+}
+
+const char* LogManager::read_message(uint32_t& time) {
+    auto length = _ring.read(_buffer, BUFFER_SIZE);
+    if (!length) {
+        return nullptr;
+    }
+
+    memcpy(&time, _buffer, sizeof(time));
+
+    auto message = _buffer + RECORD_HEADER_SIZE;
+
+    if ((RecordType)_buffer[sizeof(time)] == RecordType::Deferred) {
+        const char* format;
+        memcpy(&format, message, sizeof(format));
+
+        auto args = (const uint8_t*)message + sizeof(format);
+        auto args_length = length - RECORD_HEADER_SIZE - sizeof(format);
+
+        if (LogFormat::render(format, args, args_length, _message_buffer, BUFFER_SIZE) < 0) {
+            strcpy(_message_buffer, "(corrupt log record)");
+        }
+
+        message = _message_buffer;
+    }
+
+    return message;
+}
+
+void LogManager::spool_ring() {
+    uint32_t time;
+    size_t count = 0;
+
+    while (auto message = read_message(time)) {
+        _spool.append(time, message);
+        count++;
+    }
+
+    _spool.flush();
+
+    ESP_LOGI(TAG, "Wrote %d log messages to flash before restart", (int)count);
+}
+
+void LogManager::append_header(string& buffer, uint32_t uptime, bool previous_boot) {
+    NdjsonWriter writer(buffer);
+
+    writer.begin_object();
+    writer.add_string("entity_id", _configuration.load()->get_device_entity_id().c_str());
+    writer.add_number("uptime", uptime);
+    writer.add_bool("previous_boot", previous_boot);
+    writer.add_number("batches", _uploaded_batches);
+    writer.add_number("bytes", _uploaded_bytes);
+    writer.add_number("compressed_bytes", _compressed_bytes);
+    writer.add_number("upload_ms", _upload_ms);
+    writer.end_object();
+}
+
+void LogManager::append_message(string& buffer, const char* message, uint32_t relative_time) {
+    NdjsonWriter writer(buffer);
+
+    writer.begin_object();
+    writer.add_string("message", message);
+    writer.add_number("relative_time", relative_time);
+    writer.end_object();
+}
+
+void LogManager::append_recovered_message(string& buffer, const char* message, uint32_t uptime) {
+    NdjsonWriter writer(buffer);
+
+    writer.begin_object();
+    writer.add_string("message", message);
+    writer.add_number("uptime", uptime);
+    writer.end_object();
+}
@@ -1,33 +1,80 @@
 #pragma once
 
+#include <atomic>
+
 #include "DeviceConfiguration.h"
+#include "GzipEncoder.h"
+#include "LogFilter.h"
+#include "HttpConnectionManager.h"
+#include "LogRing.h"
+#include "LogSpool.h"
 
-class LogManager {
-    struct Message {
-        char* buffer;
-        uint32_t time;
+struct LogUploadStatistics {
+    uint32_t batches;
+    uint32_t bytes;
+    uint32_t compressed_bytes;
+    uint32_t upload_ms;
+};
 
-        Message(char* buffer, uint32_t time) : buffer(buffer), time(time) {}
-    };
+class LogManager {
+    enum class RecordType : uint8_t { Text, Deferred };
 
     static LogManager* _instance;
     static char* _buffer;
+    static char* _message_buffer;
 
+    HttpConnectionManager* _http_connection_manager;
     vprintf_like_t _default_log_handler;
+    LogFilter _filter;
+    // Log messages are captured into the ring without allocating or
+    // locking.
+    LogRing _ring;
+    // Messages are written to flash before they're uploaded and when the
+    // device restarts, so the ones that didn't make it out before a reset
+    // can be uploaded after it.
+    LogSpool _spool;
+    // Serializes reading the ring, which supports a single reader, and
+    // writing the spool between the upload task and the shutdown handler.
+    // It isn't held during an upload.
     Mutex _mutex;
-    vector<Message> _messages;
-    const DeviceConfiguration* _configuration;
-    esp_timer_handle_t _log_timer;
+    std::atomic<const DeviceConfiguration*> _configuration;
+    // Uploads run on their own low priority task, so a slow upload doesn't
+    // hold up the esp_timer task. Capturing a message wakes it when no
+    // upload is pending yet, and again when the ring is filling up.
+    TaskHandle_t _upload_task;
+    std::atomic<bool> _upload_requested;
+    std::atomic<bool> _flush_requested;
+    uint32_t _reported_dropped;
+    string _upload_buffer;
+    // A batch that failed to upload stays in the upload buffer and is sent
+    // again before anything else, as its messages have left the ring.
+    bool _batch_pending;
+    uint64_t _batch_position;
+    string _compressed_buffer;
+    GzipEncoder _gzip;
+    std::atomic<uint32_t> _uploaded_batches;
+    std::atomic<uint32_t> _uploaded_bytes;
+    std::atomic<uint32_t> _compressed_bytes;
+    std::atomic<uint32_t> _upload_ms;
 
     static int log_handler(const char* message, va_list va);
 
 public:
-    LogManager();
+    LogManager(HttpConnectionManager* http_connection_manager);
 
     void begin();
     void set_configuration(const DeviceConfiguration& configuration);
+    LogUploadStatistics get_statistics() const;
 
 private:
-    void uploadLogs();
-    void start_timer();
+    void capture(const char* message, va_list va);
+    void upload_task();
+    bool uploadLogs();
+    bool upload_recovered();
+    bool upload(const string& buffer);
+    const char* read_message(uint32_t& time);
+    void spool_ring();
+    void append_header(string& buffer, uint32_t uptime, bool previous_boot);
+    void append_message(string& buffer, const char* message, uint32_t relative_time);
+    void append_recovered_message(string& buffer, const char* message, uint32_t uptime);
 };
@@ -0,0 +1,164 @@
+#include "includes.h"
+
+#include "LogRing.h"
+
+LogRing::LogRing(uint32_t capacity, LogRingPolicy policy)
+    : _capacity(capacity), _policy(policy), _write(0), _read(0), _dropped(0), _freeing(false) {
+    if (capacity < 64 || (capacity & (capacity - 1)) != 0) {
+        abort();
+    }
+
+#ifdef LV_SIMULATOR
+    _buffer = (uint8_t*)malloc(capacity);
+#else
+    _buffer = (uint8_t*)heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM);
+#endif
+    if (!_buffer) {
+        abort();
+    }
+
+    memset(_buffer, 0xff, capacity);
+}
+
+LogRing::~LogRing() {
+#ifdef LV_SIMULATOR
+    free(_buffer);
+#else
+    heap_caps_free(_buffer);
+#endif
+}
+
+LogRing::Reservation LogRing::reserve(uint32_t length) {
+    const auto size = get_record_size(length);
+    if (size > _capacity / 2) {
+        _dropped++;
+        return {};
+    }
+
+    auto write = _write.load(std::memory_order_relaxed);
+
+    while (true) {
+        // A record that would cross the end of the buffer is preceded by a
+        // padding record up to the end.
+        const auto offset = write & (_capacity - 1);
+        const auto padding = offset + size > _capacity ? _capacity - offset : 0;
+        const auto needed = padding + size;
+
+        const auto read = _read.load(std::memory_order_acquire);
+        if (write - read + needed > _capacity) {
+            if (_policy == LogRingPolicy::OverwriteOldest && discard_oldest()) {
+                write = _write.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            _dropped++;
+            return {};
+        }
+
+        if (!_write.compare_exchange_weak(write, write + needed, std::memory_order_acq_rel,
+                                          std::memory_order_relaxed)) {
+            continue;
+        }
+
+        if (padding) {
+            auto header = get_header(write);
+            header->length = PADDING;
+            __atomic_store_n(&header->position, write, __ATOMIC_RELEASE);
+        }
+
+        const auto position = write + padding;
+        get_header(position)->length = length;
+
+        return {_buffer + (position & (_capacity - 1)) + sizeof(Header), position};
+    }
+}
+
+void LogRing::commit(const Reservation& reservation) {
+    __atomic_store_n(&get_header(reservation.position)->position, reservation.position, __ATOMIC_RELEASE);
+}
+
+uint32_t LogRing::read(void* target, uint32_t size) {
+    while (true) {
+        auto read = _read.load(std::memory_order_acquire);
+        if (read == _write.load(std::memory_order_acquire)) {
+            return 0;
+        }
+
+        auto header = get_header(read);
+        if (__atomic_load_n(&header->position, __ATOMIC_ACQUIRE) != read) {
+            // The oldest record hasn't been committed yet.
+            return 0;
+        }
+
+        const auto length = header->length;
+        const auto padding = length == PADDING;
+        const auto fits = !padding && length <= size;
+
+        if (fits) {
+            memcpy(target, header + 1, length);
+        }
+
+        // Don't wait for a producer that's discarding records; it may be
+        // preempted by us.
+        if (_freeing.exchange(true, std::memory_order_acquire)) {
+            return 0;
+        }
+
+        // A producer may have discarded the record while it was being
+        // copied; the copy is thrown away then.
+        const auto discarded = _read.load(std::memory_order_relaxed) != read;
+        if (!discarded) {
+            release(read, get_next(read, length));
+        }
+
+        _freeing.store(false, std::memory_order_release);
+
+        if (discarded || padding) {
+            continue;
+        }
+        if (fits) {
+            return length;
+        }
+
+        _dropped++;
+    }
+}
+
+uint32_t LogRing::get_next(uint32_t position, uint32_t length) const {
+    if (length == PADDING) {
+        return position + _capacity - (position & (_capacity - 1));
+    }
+    return position + get_record_size(length);
+}
+
+bool LogRing::discard_oldest() {
+    if (_freeing.exchange(true, std::memory_order_acquire)) {
+        return false;
+    }
+
+    auto result = false;
+    const auto read = _read.load(std::memory_order_relaxed);
+
+    // The oldest record can only be skipped once it's committed.
+    if (read != _write.load(std::memory_order_acquire) &&
+        __atomic_load_n(&get_header(read)->position, __ATOMIC_ACQUIRE) == read) {
+        const auto length = get_header(read)->length;
+        release(read, get_next(read, length));
+        if (length != PADDING) {
+            _dropped++;
+        }
+        result = true;
+    }
+
+    _freeing.store(false, std::memory_order_release);
+
+    return result;
+}
+
+void LogRing::release(uint32_t read, uint32_t next) {
+    // Wipe the record so stale data can't look like a committed header once
+    // the space is reused.
+    memset(_buffer + (read & (_capacity - 1)), 0xff, next - read);
+
+    _read.store(next, std::memory_order_release);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+
+enum class LogRingPolicy { DropNewest, OverwriteOldest };
+
+// Lock-free multi-producer, single-consumer ring buffer of variable length
+// records in preallocated memory. Producers never allocate or block; when
+// the ring is full the record is dropped or the oldest records are
+// discarded, depending on the policy. Either way the dropped counter is
+// incremented.
+//
+// Every record starts with a header of two words: the position of the record,
+// stored last to commit it, and the length. Freed records are filled with
+// 0xff, which never is a valid position, so a reserved record can't be taken
+// for a committed one. Freeing is serialized with a flag that producers only
+// try to take. Records don't wrap; a padding record fills the end of the
+// buffer instead.
+class LogRing {
+    struct Header {
+        uint32_t position;
+        uint32_t length;
+    };
+
+    static constexpr uint32_t PADDING = UINT32_MAX;
+
+    uint8_t* _buffer;
+    uint32_t _capacity;
+    LogRingPolicy _policy;
+    std::atomic<uint32_t> _write;
+    std::atomic<uint32_t> _read;
+    std::atomic<uint32_t> _dropped;
+    std::atomic<bool> _freeing;
+
+public:
+    struct Reservation {
+        uint8_t* data;
+        uint32_t position;
+
+        explicit operator bool() const { return data != nullptr; }
+    };
+
+    // capacity must be a power of two.
+    LogRing(uint32_t capacity, LogRingPolicy policy);
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+    LogRing(LogRing&&) = delete;
+    LogRing& operator=(LogRing&&) = delete;
+    ~LogRing();
+
+    // Reserves space for a record of length bytes. Write the record into
+    // data and pass the reservation to commit. Returns an empty reservation
+    // when the record was dropped.
+    Reservation reserve(uint32_t length);
+    void commit(const Reservation& reservation);
+
+    // Copies the oldest record into target and removes it. Returns the
+    // length of the record, or zero when no committed record is available
+    // or a producer is discarding records. Records larger than size are
+    // discarded. Must only be called from a single task.
+    uint32_t read(void* target, uint32_t size);
+
+    bool empty() const { return _read.load() == _write.load(); }
+    uint32_t get_used() const { return _write.load() - _read.load(); }
+    uint32_t get_dropped() const { return _dropped.load(); }
+    uint32_t get_capacity() const { return _capacity; }
+
+private:
+    Header* get_header(uint32_t position) const { return (Header*)(_buffer + (position & (_capacity - 1))); }
+    static uint32_t get_record_size(uint32_t length) { return (sizeof(Header) + length + 7) & ~7u; }
+    uint32_t get_next(uint32_t position, uint32_t length) const;
+    bool discard_oldest();
+    void release(uint32_t read, uint32_t next);
+};
@@ -0,0 +1,287 @@
+#include "includes.h"
+
+#ifndef LV_SIMULATOR
+
+#include "LogSpool.h"
+
+LOG_TAG(LogSpool);
+
+constexpr auto PARTITION_LABEL = "logs";
+
+static constexpr uint32_t align4(uint32_t value) { return (value + 3) & ~3u; }
+
+LogSpool::LogSpool()
+    : _partition(nullptr),
+      _sector_count(0),
+      _sequence(0),
+      _offset(0),
+      _write_buffer(new uint8_t[WRITE_BUFFER_SIZE]),
+      _buffered(0),
+      _acknowledged(0),
+      _read_position(0),
+      _recovered_end(0),
+      _recovered_count(0) {}
+
+LogSpool::~LogSpool() { delete[] _write_buffer; }
+
+void LogSpool::begin() {
+    auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, PARTITION_LABEL);
+    if (!partition) {
+        ESP_LOGW(TAG, "Partition %s not found", PARTITION_LABEL);
+        return;
+    }
+    if (partition->size / SECTOR_SIZE < 3) {
+        ESP_LOGW(TAG, "Partition %s is too small", PARTITION_LABEL);
+        return;
+    }
+
+    _partition = partition;
+    _sector_count = partition->size / SECTOR_SIZE;
+
+    auto found = false;
+    uint32_t newest = 0;
+
+    for (uint32_t i = 0; i < _sector_count; i++) {
+        SectorHeader header;
+        if (esp_partition_read(_partition, i * SECTOR_SIZE, &header, sizeof(header)) == ESP_OK &&
+            header.magic == MAGIC && header.sequence % _sector_count == i && (!found || header.sequence > newest)) {
+            newest = header.sequence;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        ESP_LOGI(TAG, "Initializing log spool");
+
+        if (esp_partition_erase_range(_partition, 0, SECTOR_SIZE) != ESP_OK) {
+            _partition = nullptr;
+            return;
+        }
+
+        enter_sector(0);
+        return;
+    }
+
+    // The sector after the newest one is always erased, so at most all
+    // other sectors hold records.
+    auto oldest = newest;
+    while (oldest > 0 && newest - oldest + 2 < _sector_count && has_sequence(oldest - 1)) {
+        oldest--;
+    }
+
+    _sequence = newest;
+
+    const auto start = (uint64_t)oldest * SECTOR_SIZE;
+    const auto end = (uint64_t)(newest + 1) * SECTOR_SIZE;
+
+    uint8_t payload[sizeof(uint64_t)];
+    uint16_t length;
+
+    auto acknowledged = start;
+    auto position = start;
+    while (read_record(position, end, payload, sizeof(payload), length)) {
+        if (length & ACK_FLAG) {
+            uint64_t value;
+            memcpy(&value, payload, sizeof(value));
+            acknowledged = max(acknowledged, value);
+        }
+    }
+
+    // Don't append to a sector that may end in a torn write. Entering the
+    // next sector erases the oldest one, so count what's left after that.
+    enter_sector(newest + 1);
+
+    size_t count = 0;
+    position = acknowledged;
+    while (read_record(position, end, payload, sizeof(payload), length)) {
+        if (!(length & ACK_FLAG)) {
+            count++;
+        }
+    }
+
+    _acknowledged = acknowledged;
+    _read_position = acknowledged;
+    _recovered_end = end;
+    _recovered_count = count;
+
+    ESP_LOGI(TAG, "Found %d unsent log messages in sectors %" PRIu32 " to %" PRIu32, (int)count, oldest, newest);
+}
+
+uint64_t LogSpool::append(uint32_t time, const char* message) {
+    if (!_partition) {
+        return 0;
+    }
+
+    auto length = min(strlen(message), WRITE_BUFFER_SIZE - sizeof(RecordHeader) - sizeof(time) - 4);
+
+    write_record(0, &time, sizeof(time), message, length);
+
+    return get_position();
+}
+
+void LogSpool::flush() {
+    if (!_partition || !_buffered) {
+        return;
+    }
+
+    const auto offset = (_sequence % _sector_count) * SECTOR_SIZE + _offset - _buffered;
+
+    auto err = esp_partition_write(_partition, offset, _write_buffer, _buffered);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write to the log spool: %s", esp_err_to_name(err));
+    }
+
+    _buffered = 0;
+}
+
+void LogSpool::acknowledge(uint64_t position) {
+    if (!_partition || !position) {
+        return;
+    }
+
+    write_record(ACK_FLAG, &position, sizeof(position), nullptr, 0);
+    flush();
+
+    _acknowledged = position;
+}
+
+bool LogSpool::read_recovered(uint32_t& time, char* message, size_t size, uint64_t& position) {
+    if (!_partition) {
+        return false;
+    }
+
+    uint16_t length;
+    while (read_record(_read_position, _recovered_end, (uint8_t*)message, size - 1, length)) {
+        if (length & ACK_FLAG || length < sizeof(time)) {
+            continue;
+        }
+
+        length = min((size_t)length, size - 1);
+
+        memcpy(&time, message, sizeof(time));
+        memmove(message, message + sizeof(time), length - sizeof(time));
+        message[length - sizeof(time)] = 0;
+
+        position = _read_position;
+        return true;
+    }
+
+    return false;
+}
+
+void LogSpool::finish_recovered() {
+    _read_position = _recovered_end;
+    _recovered_count = 0;
+}
+
+bool LogSpool::read_record(uint64_t& position, uint64_t end, uint8_t* payload, size_t size, uint16_t& length) {
+    while (position < end) {
+        const auto sequence = (uint32_t)(position / SECTOR_SIZE);
+        const auto offset = (uint32_t)(position % SECTOR_SIZE);
+        const auto next_sector = (uint64_t)(sequence + 1) * SECTOR_SIZE;
+
+        // Sectors that have been erased since don't hold anything anymore.
+        const auto oldest = _sequence + 2 > _sector_count ? _sequence + 2 - _sector_count : 0;
+        if (sequence < oldest) {
+            position = (uint64_t)oldest * SECTOR_SIZE;
+            continue;
+        }
+
+        if (offset < sizeof(SectorHeader)) {
+            position += sizeof(SectorHeader) - offset;
+            continue;
+        }
+
+        const auto address = (sequence % _sector_count) * SECTOR_SIZE + offset;
+
+        // Erased flash or a torn write ends the records of a sector.
+        RecordHeader header;
+        if (offset + sizeof(header) > SECTOR_SIZE ||
+            esp_partition_read(_partition, address, &header, sizeof(header)) != ESP_OK ||
+            header.check != (uint16_t)~header.length) {
+            position = next_sector;
+            continue;
+        }
+
+        const auto payload_length = header.length & ~ACK_FLAG;
+        const auto record_size = align4(sizeof(header) + payload_length);
+        if (offset + record_size > SECTOR_SIZE) {
+            position = next_sector;
+            continue;
+        }
+
+        if (esp_partition_read(_partition, address + sizeof(header), payload, min((size_t)payload_length, size)) !=
+            ESP_OK) {
+            position = next_sector;
+            continue;
+        }
+
+        position += record_size;
+        length = header.length;
+        return true;
+    }
+
+    return false;
+}
+
+void LogSpool::write_record(uint16_t flags, const void* prefix, size_t prefix_length, const void* data,
+                            size_t data_length) {
+    const auto payload_length = prefix_length + data_length;
+    const auto record_size = align4(sizeof(RecordHeader) + payload_length);
+
+    if (_offset + record_size > SECTOR_SIZE) {
+        flush();
+        enter_sector(_sequence + 1);
+    }
+    if (_buffered + record_size > WRITE_BUFFER_SIZE) {
+        flush();
+    }
+
+    RecordHeader header = {
+        .length = (uint16_t)(payload_length | flags),
+        .check = (uint16_t) ~(payload_length | flags),
+    };
+
+    auto target = _write_buffer + _buffered;
+    memcpy(target, &header, sizeof(header));
+    memcpy(target + sizeof(header), prefix, prefix_length);
+    if (data_length) {
+        memcpy(target + sizeof(header) + prefix_length, data, data_length);
+    }
+    memset(target + sizeof(header) + payload_length, 0xff, record_size - sizeof(header) - payload_length);
+
+    _buffered += record_size;
+    _offset += record_size;
+}
+
+bool LogSpool::has_sequence(uint32_t sequence) {
+    SectorHeader header;
+    return esp_partition_read(_partition, (sequence % _sector_count) * SECTOR_SIZE, &header, sizeof(header)) ==
+               ESP_OK &&
+           header.magic == MAGIC && header.sequence == sequence;
+}
+
+void LogSpool::enter_sector(uint32_t sequence) {
+    // Erase the sector after this one first. This keeps the invariant that
+    // the sector after the newest one is erased, even when we're reset
+    // halfway.
+    auto err = esp_partition_erase_range(_partition, ((sequence + 1) % _sector_count) * SECTOR_SIZE, SECTOR_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to erase log spool sector: %s", esp_err_to_name(err));
+    }
+
+    SectorHeader header = {
+        .magic = MAGIC,
+        .sequence = sequence,
+    };
+
+    err = esp_partition_write(_partition, (sequence % _sector_count) * SECTOR_SIZE, &header, sizeof(header));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write log spool sector header: %s", esp_err_to_name(err));
+    }
+
+    _sequence = sequence;
+    _offset = sizeof(SectorHeader);
+}
+
+#endif
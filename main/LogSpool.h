@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef LV_SIMULATOR
+
+// Circular log spool in the "logs" flash partition. LogManager appends every
+// message it uploads, and the ones still waiting when the device restarts,
+// and acknowledges a batch once it has been uploaded, so messages that never
+// made it out before a crash, power loss or restart can be uploaded after it.
+//
+// The partition is used as a ring of sectors. Sector n of the ring is
+// stored in physical sector n % sector count and starts with a header
+// holding n. Records are a length, its complement and the payload, padded
+// to four bytes. Message records hold the capture time and the text; records
+// flagged as acknowledgement hold the position up to which records were
+// uploaded. Writing moves through all sectors in turn, which levels wear, and
+// the next sector is erased when a sector is entered, so appending never
+// waits for an erase of the sector it writes.
+class LogSpool {
+    struct SectorHeader {
+        uint32_t magic;
+        uint32_t sequence;
+    };
+
+    struct RecordHeader {
+        uint16_t length;
+        uint16_t check;
+    };
+
+    static constexpr uint32_t MAGIC = 0x53474f4c;  // "LOGS"
+    static constexpr uint16_t ACK_FLAG = 0x8000;
+    static constexpr uint32_t SECTOR_SIZE = SPI_FLASH_SEC_SIZE;
+    static constexpr size_t WRITE_BUFFER_SIZE = 1024;
+
+    const esp_partition_t* _partition;
+    uint32_t _sector_count;
+    uint32_t _sequence;
+    uint32_t _offset;
+    uint8_t* _write_buffer;
+    size_t _buffered;
+    uint64_t _acknowledged;
+    uint64_t _read_position;
+    uint64_t _recovered_end;
+    size_t _recovered_count;
+
+public:
+    LogSpool();
+    LogSpool(const LogSpool&) = delete;
+    LogSpool& operator=(const LogSpool&) = delete;
+    LogSpool(LogSpool&&) = delete;
+    LogSpool& operator=(LogSpool&&) = delete;
+    ~LogSpool();
+
+    // Finds the write position and the messages of earlier runs that weren't
+    // acknowledged.
+    void begin();
+
+    // Appends a message and returns the position after it, to be passed to
+    // acknowledge once it has been uploaded.
+    uint64_t append(uint32_t time, const char* message);
+    void flush();
+    void acknowledge(uint64_t position);
+
+    // Reads the unacknowledged messages from earlier runs, oldest first.
+    size_t get_recovered_count() const { return _recovered_count; }
+    bool read_recovered(uint32_t& time, char* message, size_t size, uint64_t& position);
+    void rewind_recovered() { _read_position = _acknowledged; }
+    void finish_recovered();
+
+private:
+    uint64_t get_position() const { return (uint64_t)_sequence * SECTOR_SIZE + _offset; }
+    bool read_record(uint64_t& position, uint64_t end, uint8_t* payload, size_t size, uint16_t& length);
+    void write_record(uint16_t flags, const void* prefix, size_t prefix_length, const void* data, size_t data_length);
+    bool has_sequence(uint32_t sequence);
+    void enter_sector(uint32_t sequence);
+};
+
+#endif
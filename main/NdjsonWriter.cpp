@@ -0,0 +1,91 @@
+#include "includes.h"
+
+#include "NdjsonWriter.h"
+
+void NdjsonWriter::begin_object() {
+    _buffer.push_back('{');
+    _first = true;
+}
+
+void NdjsonWriter::end_object() { _buffer.append("}\n"); }
+
+void NdjsonWriter::add_string(const char* key, const char* value) {
+    add_key(key);
+
+    _buffer.push_back('"');
+    append_escaped(_buffer, value);
+    _buffer.push_back('"');
+}
+
+void NdjsonWriter::add_number(const char* key, int64_t value) {
+    add_key(key);
+
+    char number[24];
+    auto length = snprintf(number, sizeof(number), "%lld", (long long)value);
+    _buffer.append(number, length);
+}
+
+void NdjsonWriter::add_bool(const char* key, bool value) {
+    add_key(key);
+
+    _buffer.append(value ? "true" : "false");
+}
+
+void NdjsonWriter::add_key(const char* key) {
+    if (!_first) {
+        _buffer.push_back(',');
+    }
+    _first = false;
+
+    _buffer.push_back('"');
+    _buffer.append(key);
+    _buffer.append("\":");
+}
+
+void NdjsonWriter::append_escaped(string& buffer, const char* value) {
+    static const char HEX[] = "0123456789abcdef";
+
+    auto start = value;
+
+    for (auto p = value; *p; p++) {
+        const auto c = (uint8_t)*p;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        // Copy the run of characters that don't need escaping at once.
+        buffer.append(start, p - start);
+        start = p + 1;
+
+        switch (c) {
+            case '"':
+                buffer.append("\\\"");
+                break;
+            case '\\':
+                buffer.append("\\\\");
+                break;
+            case '\b':
+                buffer.append("\\b");
+                break;
+            case '\f':
+                buffer.append("\\f");
+                break;
+            case '\n':
+                buffer.append("\\n");
+                break;
+            case '\r':
+                buffer.append("\\r");
+                break;
+            case '\t':
+                buffer.append("\\t");
+                break;
+            default: {
+                const char escaped[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf]};
+                buffer.append(escaped, sizeof(escaped));
+                break;
+            }
+        }
+    }
+
+    buffer.append(start);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// Writes newline delimited JSON objects straight into a buffer, without
+// building a cJSON tree. Keys are written as is and must not need escaping.
+class NdjsonWriter {
+    string& _buffer;
+    bool _first;
+
+public:
+    NdjsonWriter(string& buffer) : _buffer(buffer), _first(true) {}
+
+    void begin_object();
+    void end_object();
+
+    void add_string(const char* key, const char* value);
+    void add_number(const char* key, int64_t value);
+    void add_bool(const char* key, bool value);
+
+    static void append_escaped(string& buffer, const char* value);
+
+private:
+    void add_key(const char* key);
+};
@@ -6,10 +6,20 @@
 
 LOG_TAG(NetworkConnection);
 
+constexpr auto NVS_NAMESPACE = "network";
+constexpr auto NVS_CACHE_KEY = "cache";
+
 NetworkConnection *NetworkConnection::_instance = nullptr;
 
 NetworkConnection::NetworkConnection(Queue *synchronizationQueue)
-    : _synchronization_queue(synchronizationQueue), _attempt(0), _have_sntp_synced(false) {
+    : _synchronization_queue(synchronizationQueue),
+      _netif(nullptr),
+      _attempt(0),
+      _have_sntp_synced(false),
+      _cache(),
+      _have_cache(false),
+      _using_cache(false),
+      _static_ip(false) {
     _instance = this;
 }
 
@@ -19,7 +29,7 @@ void NetworkConnection::begin() {
     ESP_ERROR_CHECK(esp_netif_init());
 
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    _netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -63,6 +73,20 @@ void NetworkConnection::begin() {
             },
     };
 
+    _have_cache = load_cache();
+
+    if (_have_cache) {
+        ESP_LOGI(TAG, "Connecting to cached access point " MACSTR " on channel %d", MAC2STR(_cache.bssid),
+                 _cache.channel);
+
+        // Only the channel of the access point is scanned.
+        wifiConfig.sta.bssid_set = true;
+        memcpy(wifiConfig.sta.bssid, _cache.bssid, sizeof(wifiConfig.sta.bssid));
+        wifiConfig.sta.channel = _cache.channel;
+
+        _using_cache = true;
+    }
+
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifiConfig));
     ESP_ERROR_CHECK(esp_wifi_start());
@@ -74,6 +98,14 @@ void NetworkConnection::event_handler(esp_event_base_t eventBase, int32_t eventI
     if (eventBase == WIFI_EVENT && eventId == WIFI_EVENT_STA_START) {
         ESP_LOGI(TAG, "Connecting to AP, attempt %d", _attempt + 1);
         esp_wifi_connect();
+    } else if (eventBase == WIFI_EVENT && eventId == WIFI_EVENT_STA_CONNECTED) {
+        ESP_LOGI(TAG, "Associated %d ms after boot", (int)(esp_timer_get_time() / 1000));
+
+#ifdef CONFIG_WIFI_CACHED_STATIC_IP
+        if (_using_cache) {
+            set_static_ip();
+        }
+#endif
     } else if (eventBase == WIFI_EVENT && eventId == WIFI_EVENT_STA_DISCONNECTED) {
         auto event = (wifi_event_sta_disconnected_t *)eventData;
 
@@ -82,6 +114,15 @@ void NetworkConnection::event_handler(esp_event_base_t eventBase, int32_t eventI
 
         ESP_LOGW(TAG, "Disconnected from AP, reason %d", event->reason);
 
+        // The cached access point may be gone or have moved to another
+        // channel. Scanning for the SSID doesn't count as a retry.
+        if (_using_cache) {
+            ESP_LOGI(TAG, "Scanning for the access point");
+            stop_using_cache();
+            esp_wifi_connect();
+            return;
+        }
+
         if (_attempt++ < CONFIG_DEVICE_NETWORK_CONNECT_ATTEMPTS) {
             ESP_LOGI(TAG, "Retrying...");
             esp_wifi_connect();
@@ -91,12 +132,125 @@ void NetworkConnection::event_handler(esp_event_base_t eventBase, int32_t eventI
     } else if (eventBase == IP_EVENT && eventId == IP_EVENT_STA_GOT_IP) {
         auto event = (ip_event_got_ip_t *)eventData;
 
-        ESP_LOGI(TAG, "Got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+        ESP_LOGI(TAG, "Got ip:" IPSTR " %d ms after boot%s", IP2STR(&event->ip_info.ip),
+                 (int)(esp_timer_get_time() / 1000), _using_cache ? " using the cached access point" : "");
+
+        save_cache(event->ip_info);
 
         setup_sntp();
     }
 }
 
+void NetworkConnection::set_static_ip() {
+    // Reuses the last DHCP lease, which saves the DHCP round trips.
+    auto err = esp_netif_dhcpc_stop(_netif);
+    if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+        ESP_LOGW(TAG, "Failed to stop DHCP client: %s", esp_err_to_name(err));
+        return;
+    }
+
+    esp_netif_ip_info_t ipInfo = {};
+    ipInfo.ip.addr = _cache.ip;
+    ipInfo.netmask.addr = _cache.netmask;
+    ipInfo.gw.addr = _cache.gateway;
+
+    esp_netif_dns_info_t dnsInfo = {};
+    dnsInfo.ip.type = ESP_IPADDR_TYPE_V4;
+    dnsInfo.ip.u_addr.ip4.addr = _cache.dns;
+
+    err = esp_netif_set_ip_info(_netif, &ipInfo);
+    if (err == ESP_OK) {
+        err = esp_netif_set_dns_info(_netif, ESP_NETIF_DNS_MAIN, &dnsInfo);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set static IP: %s", esp_err_to_name(err));
+        esp_netif_dhcpc_start(_netif);
+        return;
+    }
+
+    _static_ip = true;
+
+    ESP_LOGI(TAG, "Using cached IP " IPSTR, IP2STR(&ipInfo.ip));
+}
+
+void NetworkConnection::stop_using_cache() {
+    _using_cache = false;
+
+    if (_static_ip) {
+        _static_ip = false;
+        esp_netif_dhcpc_start(_netif);
+    }
+
+    wifi_config_t wifiConfig;
+    ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &wifiConfig));
+
+    wifiConfig.sta.bssid_set = false;
+    wifiConfig.sta.channel = 0;
+
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifiConfig));
+}
+
+bool NetworkConnection::load_cache() {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+
+    auto length = sizeof(_cache);
+    auto err = nvs_get_blob(handle, NVS_CACHE_KEY, &_cache, &length);
+
+    nvs_close(handle);
+
+    return err == ESP_OK && length == sizeof(_cache);
+}
+
+void NetworkConnection::save_cache(const esp_netif_ip_info_t &ipInfo) {
+    wifi_ap_record_t apInfo;
+    if (esp_wifi_sta_get_ap_info(&apInfo) != ESP_OK) {
+        return;
+    }
+
+    esp_netif_dns_info_t dnsInfo;
+    if (esp_netif_get_dns_info(_netif, ESP_NETIF_DNS_MAIN, &dnsInfo) != ESP_OK) {
+        return;
+    }
+
+    // Zeroed so the padding compares equal.
+    NetworkConnectionCache cache;
+    memset(&cache, 0, sizeof(cache));
+
+    memcpy(cache.bssid, apInfo.bssid, sizeof(cache.bssid));
+    cache.channel = apInfo.primary;
+    cache.ip = ipInfo.ip.addr;
+    cache.netmask = ipInfo.netmask.addr;
+    cache.gateway = ipInfo.gw.addr;
+    cache.dns = dnsInfo.ip.u_addr.ip4.addr;
+
+    // Most boots connect the same way; don't wear the flash for those.
+    if (_have_cache && memcmp(&cache, &_cache, sizeof(cache)) == 0) {
+        return;
+    }
+
+    nvs_handle_t handle;
+    auto err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, NVS_CACHE_KEY, &cache, sizeof(cache));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+
+        nvs_close(handle);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save connection cache: %s", esp_err_to_name(err));
+        return;
+    }
+
+    _cache = cache;
+    _have_cache = true;
+}
+
 void NetworkConnection::setup_sntp() {
     ESP_LOGI(TAG, "Initializing SNTP");
 
@@ -113,6 +267,8 @@ void NetworkConnection::setup_sntp() {
         if (!_instance->_have_sntp_synced) {
             _instance->_have_sntp_synced = true;
 
+            ESP_LOGI(TAG, "Connected %d ms after boot", (int)(esp_timer_get_time() / 1000));
+
             _instance->_state_changed.queue(_instance->_synchronization_queue, {.connected = true, .errorReason = 0});
         }
     };
@@ -5,13 +5,30 @@ struct NetworkConnectionState {
     uint8_t errorReason;
 };
 
+// Access point and DHCP lease of the last successful connection, stored in
+// NVS. On the next boot the device connects to the same access point
+// directly instead of scanning every channel for the SSID.
+struct NetworkConnectionCache {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gateway;
+    uint32_t dns;
+};
+
 class NetworkConnection {
     static NetworkConnection *_instance;
     Queue *_synchronization_queue;
     EventGroupHandle_t _wifi_event_group;
+    esp_netif_t *_netif;
     Callback<NetworkConnectionState> _state_changed;
     int _attempt;
     bool _have_sntp_synced;
+    NetworkConnectionCache _cache;
+    bool _have_cache;
+    bool _using_cache;
+    bool _static_ip;
 
 public:
     NetworkConnection(Queue *synchronizationQueue);
@@ -21,5 +38,9 @@ public:
 
 private:
     void event_handler(esp_event_base_t eventBase, int32_t eventId, void *eventData);
+    void set_static_ip();
+    void stop_using_cache();
+    bool load_cache();
+    void save_cache(const esp_netif_ip_info_t &ipInfo);
     void setup_sntp();
 };
@@ -0,0 +1,109 @@
+#include "includes.h"
+
+#include "NodeHistory.h"
+
+NodeHistory::NodeHistory() : _head(0), _count(0) {
+#ifdef LV_SIMULATOR
+    _storage = (Storage*)malloc(sizeof(Storage));
+#else
+    _storage = (Storage*)heap_caps_malloc(sizeof(Storage), MALLOC_CAP_SPIRAM);
+#endif
+    if (!_storage) {
+        abort();
+    }
+
+    memset(_storage->names, 0, sizeof(_storage->names));
+    memset(_storage->cpu, NO_SAMPLE, sizeof(_storage->cpu));
+    memset(_storage->memory, NO_SAMPLE, sizeof(_storage->memory));
+}
+
+NodeHistory::~NodeHistory() {
+#ifdef LV_SIMULATOR
+    free(_storage);
+#else
+    heap_caps_free(_storage);
+#endif
+}
+
+void NodeHistory::record(const NodeMetricsDto& metrics) {
+    bool seen[MAX_NODES] = {};
+    int slots[MAX_NODES];
+    const auto count = min((int)metrics.size(), MAX_NODES);
+
+    for (auto i = 0; i < count; i++) {
+        auto name = hash(metrics.names[i]);
+        slots[i] = find(name);
+        if (slots[i] >= 0) {
+            seen[slots[i]] = true;
+        }
+    }
+
+    // Nodes without a slot take over the slot of a node that's gone.
+    for (auto i = 0; i < count; i++) {
+        if (slots[i] >= 0) {
+            continue;
+        }
+
+        for (auto slot = 0; slot < MAX_NODES; slot++) {
+            if (!seen[slot]) {
+                seen[slot] = true;
+                slots[i] = slot;
+                _storage->names[slot] = hash(metrics.names[i]);
+                memset(_storage->cpu[slot], NO_SAMPLE, SAMPLES);
+                memset(_storage->memory[slot], NO_SAMPLE, SAMPLES);
+                break;
+            }
+        }
+    }
+
+    for (auto slot = 0; slot < MAX_NODES; slot++) {
+        _storage->cpu[slot][_head] = NO_SAMPLE;
+        _storage->memory[slot][_head] = NO_SAMPLE;
+    }
+
+    for (auto i = 0; i < count; i++) {
+        if (!(metrics.flags[i] & NODE_CPU_UNKNOWN)) {
+            _storage->cpu[slots[i]][_head] = (uint8_t)min(metrics.cpu_percentages[i], (uint16_t)100);
+        }
+        if (!(metrics.flags[i] & NODE_MEMORY_UNKNOWN)) {
+            _storage->memory[slots[i]][_head] = (uint8_t)min(metrics.memory_percentages[i], (uint16_t)100);
+        }
+    }
+
+    _head = (_head + 1) % SAMPLES;
+    _count = min(_count + 1, SAMPLES);
+}
+
+int NodeHistory::get_samples(const char* name, uint8_t* cpu, uint8_t* memory) const {
+    auto slot = find(hash(name));
+    if (slot < 0) {
+        return 0;
+    }
+
+    auto start = (_head - _count + SAMPLES) % SAMPLES;
+    for (auto i = 0; i < _count; i++) {
+        auto index = (start + i) % SAMPLES;
+        cpu[i] = _storage->cpu[slot][index];
+        memory[i] = _storage->memory[slot][index];
+    }
+
+    return _count;
+}
+
+int NodeHistory::find(uint32_t name) const {
+    for (auto slot = 0; slot < MAX_NODES; slot++) {
+        if (_storage->names[slot] == name) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+uint32_t NodeHistory::hash(const char* name) {
+    // FNV-1a. Zero marks a free slot.
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "StatsDto.h"
+
+// Keeps the last SAMPLES CPU and memory percentages of every node, one
+// sample per update. Samples are stored as 8-bit percentages in
+// struct-of-arrays layout in PSRAM; all nodes share the ring position.
+//
+// Memory use is fixed: per node 4 bytes for the name hash plus 2 * SAMPLES
+// bytes, i.e. 100 bytes for 48 samples and 800 bytes for all MAX_NODES.
+// Nodes beyond MAX_NODES aren't tracked.
+class NodeHistory {
+public:
+    static constexpr int MAX_NODES = 8;
+    static constexpr int SAMPLES = 48;
+    static constexpr uint8_t NO_SAMPLE = 0xff;
+
+private:
+    struct Storage {
+        uint32_t names[MAX_NODES];
+        uint8_t cpu[MAX_NODES][SAMPLES];
+        uint8_t memory[MAX_NODES][SAMPLES];
+    };
+
+    Storage* _storage;
+    int _head;
+    int _count;
+
+public:
+    NodeHistory();
+    NodeHistory(const NodeHistory&) = delete;
+    NodeHistory& operator=(const NodeHistory&) = delete;
+    NodeHistory(NodeHistory&&) = delete;
+    NodeHistory& operator=(NodeHistory&&) = delete;
+    ~NodeHistory();
+
+    void record(const NodeMetricsDto& metrics);
+
+    // Copies the samples of a node oldest first into cpu and memory, which
+    // must hold SAMPLES values. Returns the number of samples copied; missing
+    // samples are NO_SAMPLE.
+    int get_samples(const char* name, uint8_t* cpu, uint8_t* memory) const;
+
+private:
+    int find(uint32_t name) const;
+    static uint32_t hash(const char* name);
+};
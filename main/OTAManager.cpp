@@ -2,13 +2,31 @@
 
 #include "OTAManager.h"
 
+#include "DeltaPatcher.h"
+#include "Inflater.h"
+#include "OTAWriter.h"
+
 constexpr auto OTA_INITIAL_CHECK_INTERVAL = 5;
 constexpr auto HASH_LENGTH = 32;  // SHA-256 hash length
-constexpr auto BUFFER_SIZE = 1024;
+constexpr auto HEADER_SIZE = sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t);
+// Enough to decompress the image header from, even when it doesn't compress.
+constexpr auto PROBE_SIZE = 1024;
+constexpr auto READ_BUFFER_SIZE = 4096;
+constexpr auto MAX_SIGNATURE_SIZE = 1024;
+constexpr auto PROGRESS_INTERVAL = 16 * SPI_FLASH_SEC_SIZE;
+constexpr auto NVS_NAMESPACE = "ota";
+constexpr auto NVS_PROGRESS_KEY = "progress";
 
 static const char *TAG = "OTAManager";
 
-OTAManager::OTAManager() : _update_timer(nullptr) {}
+// Without a public key every update would be installed unverified, so a
+// build without one has to allow that explicitly.
+#ifndef CONFIG_OTA_ALLOW_UNSIGNED
+static_assert(sizeof(CONFIG_OTA_PUBLIC_KEY) > 1, "Set OTA_PUBLIC_KEY in the environment or enable OTA_ALLOW_UNSIGNED");
+#endif
+
+OTAManager::OTAManager(HttpConnectionManager *http_connection_manager)
+    : _http_connection_manager(http_connection_manager), _update_timer(nullptr) {}
 
 void OTAManager::begin() {
     const esp_timer_create_args_t displayOffTimerArgs = {
@@ -34,9 +52,6 @@ void OTAManager::update_check() {
 }
 
 bool OTAManager::install_update() {
-    auto firmwareInstalled = false;
-    auto otaBusy = false;
-
     auto updatePartition = esp_ota_get_next_update_partition(nullptr);
     auto runningPartition = esp_ota_get_running_partition();
 
@@ -45,25 +60,246 @@ bool OTAManager::install_update() {
         return false;
     }
 
-    auto buffer = new char[BUFFER_SIZE];
-    auto firmwareSize = 0;
-    esp_ota_handle_t updateHandle = 0;
+    esp_app_desc_t newAppInfo;
+    auto compressed = false;
+    if (!probe_update(runningPartition, newAppInfo, compressed)) {
+        return false;
+    }
+
+    // The signature is downloaded first. It can't be downloaded while the
+    // image or patch is streamed, as that holds the connection to the same
+    // origin.
+    string signature;
+    if (download_signature(signature) != ESP_OK) {
+        return false;
+    }
+
+    // Prefer a patch against the running firmware. When there is none, or
+    // it can't be applied, the full image is installed instead.
+    if (*CONFIG_OTA_DELTA_ENDPOINT) {
+        auto err = install_delta(updatePartition, runningPartition, signature);
+        if (err == ESP_OK) {
+            return true;
+        }
+        if (err == ESP_ERR_NOT_FOUND) {
+            ESP_LOGI(TAG, "No firmware patch available; installing full firmware");
+        } else {
+            ESP_LOGW(TAG, "Failed to install firmware patch: %s; installing full firmware", esp_err_to_name(err));
+        }
+    }
 
     esp_http_client_config_t config = {
         .url = CONFIG_OTA_ENDPOINT,
         .timeout_ms = CONFIG_OTA_RECV_TIMEOUT,
     };
 
-    ESP_LOGI(TAG, "Getting firmware from %s", config.url);
+    // An interrupted download of the same image continues where it
+    // stopped. Compressed images always start over; the decompressor state
+    // isn't saved.
+    Progress progress;
+    auto resume = !compressed && load_progress(progress) && progress.partition_address == updatePartition->address &&
+                  memcmp(progress.app_elf_sha256, newAppInfo.app_elf_sha256, sizeof(progress.app_elf_sha256)) == 0;
+
+    char range[32];
+    if (resume) {
+        snprintf(range, sizeof(range), "bytes=%d-", (int)progress.written);
 
-    auto client = esp_http_client_init(&config);
+        ESP_LOGI(TAG, "Resuming firmware download from %s at %d bytes", config.url, (int)progress.written);
+    } else {
+        ESP_LOGI(TAG, "Getting %sfirmware from %s", compressed ? "compressed " : "", config.url);
+    }
+
+    auto firmwareInstalled = false;
 
-    ESP_ERROR_CHECK_JUMP(esp_http_client_open(client, 0), end);
+    // The image may have changed since the probe. When the firmware is up
+    // to date after all, the stream is abandoned after the first block and
+    // the connection manager closes the connection.
+    auto err = _http_connection_manager->get(
+        config,
+        [&](auto client, auto length) {
+            if (resume) {
+                const auto status = esp_http_client_get_status_code(client);
+                if (status == 200) {
+                    ESP_LOGW(TAG, "Server ignored the range; downloading the whole firmware");
+                    resume = false;
+                } else if (status != 206) {
+                    ESP_LOGE(TAG, "Resuming firmware download failed with status %d", status);
+                    clear_progress();
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+            }
 
-    esp_http_client_fetch_headers(client);
+            firmwareInstalled =
+                compressed
+                    ? install_compressed_update_from_stream(client, updatePartition, runningPartition, signature)
+                    : install_update_from_stream(client, updatePartition, runningPartition, progress, resume,
+                                                 signature);
+            return ESP_OK;
+        },
+        resume ? range : nullptr);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to get firmware: %s", esp_err_to_name(err));
+    }
 
-    while (true) {
-        auto read = esp_http_client_read(client, buffer, BUFFER_SIZE);
+    return firmwareInstalled;
+}
+
+bool OTAManager::probe_update(const esp_partition_t *runningPartition, esp_app_desc_t &newAppInfo, bool &compressed) {
+    esp_http_client_config_t config = {
+        .url = CONFIG_OTA_ENDPOINT,
+        .timeout_ms = CONFIG_OTA_RECV_TIMEOUT,
+    };
+
+    // Only get the start of the image with the app description. A server
+    // that ignores the range sends the whole image; that stream is
+    // abandoned after the probe.
+    char range[32];
+    snprintf(range, sizeof(range), "bytes=0-%d", PROBE_SIZE - 1);
+
+    auto buffer = new uint8_t[PROBE_SIZE];
+    size_t filled = 0;
+
+    auto err = _http_connection_manager->get(
+        config,
+        [&](auto client, auto length) {
+            const auto status = esp_http_client_get_status_code(client);
+            if (status != 200 && status != 206) {
+                ESP_LOGE(TAG, "Probing firmware failed with status %d", status);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+
+            while (filled < PROBE_SIZE) {
+                auto read = esp_http_client_read(client, (char *)buffer + filled, PROBE_SIZE - filled);
+                if (read <= 0) {
+                    break;
+                }
+                filled += read;
+            }
+
+            return ESP_OK;
+        },
+        range);
+
+    auto valid = err == ESP_OK && read_app_description(buffer, filled, newAppInfo);
+
+    compressed = filled > 0 && buffer[0] == Inflater::ZLIB_MAGIC;
+
+    delete[] buffer;
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to probe firmware: %s", esp_err_to_name(err));
+        return false;
+    }
+    if (!valid) {
+        ESP_LOGE(TAG, "Did not receive enough data to parse the firmware header");
+        return false;
+    }
+
+    return is_update(newAppInfo, runningPartition);
+}
+
+bool OTAManager::read_app_description(const uint8_t *data, size_t length, esp_app_desc_t &appInfo) {
+    uint8_t header[HEADER_SIZE];
+    size_t filled = 0;
+
+    if (length > 0 && data[0] == Inflater::ZLIB_MAGIC) {
+        // Errors are ignored; the stream is incomplete and whether the
+        // header could be decompressed is checked below.
+        Inflater inflater([&](const uint8_t *data, size_t length) {
+            const auto chunk = min(length, HEADER_SIZE - filled);
+            memcpy(header + filled, data, chunk);
+            filled += chunk;
+            return ESP_OK;
+        });
+
+        inflater.write(data, length);
+    } else {
+        filled = min(length, HEADER_SIZE);
+        memcpy(header, data, filled);
+    }
+
+    if (filled < HEADER_SIZE || header[0] != ESP_IMAGE_HEADER_MAGIC) {
+        return false;
+    }
+
+    memcpy(&appInfo, &header[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)], sizeof(esp_app_desc_t));
+
+    return true;
+}
+
+bool OTAManager::is_update(const esp_app_desc_t &newAppInfo, const esp_partition_t *runningPartition) {
+    esp_app_desc_t runningAppInfo;
+    auto err = esp_ota_get_partition_description(runningPartition, &runningAppInfo);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to get running firmware description: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    ESP_LOGI(TAG, "New firmware version: %s, current %s", newAppInfo.version, runningAppInfo.version);
+
+    if (strcmp(newAppInfo.version, runningAppInfo.version) == 0) {
+        ESP_LOGI(TAG, "Firmware already up to date.");
+        return false;
+    }
+
+    auto lastInvalidApp = esp_ota_get_last_invalid_partition();
+
+    if (lastInvalidApp != nullptr) {
+        esp_app_desc_t invalidAppInfo;
+        err = esp_ota_get_partition_description(lastInvalidApp, &invalidAppInfo);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to get invalid firmware description: %s", esp_err_to_name(err));
+            return false;
+        }
+
+        ESP_LOGI(TAG, "Last invalid firmware version: %s", invalidAppInfo.version);
+
+        // Check current version with last invalid partition.
+        if (strcmp(invalidAppInfo.version, newAppInfo.version) == 0) {
+            ESP_LOGW(TAG, "Refusing to update to invalid firmware version.");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool OTAManager::install_update_from_stream(esp_http_client_handle_t client, const esp_partition_t *updatePartition,
+                                            const esp_partition_t *runningPartition, Progress &progress, bool resume,
+                                            const string &signature) {
+    auto firmwareInstalled = false;
+    auto otaBusy = false;
+    auto complete = false;
+    auto firmwareSize = 0;
+    size_t filled = 0;
+    const auto start = esp_timer_get_time();
+    const auto resumedAt = resume ? (int)progress.written : 0;
+    uint8_t hash[HASH_LENGTH];
+    esp_err_t err;
+
+    // Reading the next block from the network overlaps with writing the
+    // previous ones to flash.
+    OTAWriter writer;
+    auto buffer = writer.get_buffer();
+
+    // The writer task saves the progress at sector boundaries, once the
+    // data before it is on flash.
+    writer.on_progress([&](size_t written, const mbedtls_sha256_context &sha256) {
+        if (written % PROGRESS_INTERVAL == 0) {
+            progress.written = written;
+            mbedtls_sha256_clone(&progress.sha256, &sha256);
+            save_progress(progress);
+        }
+    });
+
+    if (resume) {
+        ESP_ERROR_CHECK_JUMP(writer.begin(updatePartition, progress.written, &progress.sha256), end);
+
+        otaBusy = true;
+    }
+
+    while (!complete) {
+        auto read = esp_http_client_read(client, (char *)buffer + filled, OTAWriter::BUFFER_SIZE - filled);
 
         if (read < 0) {
             ESP_LOGE(TAG, "Error while reading from HTTP stream");
@@ -79,17 +315,27 @@ bool OTAManager::install_update() {
                 goto end;
             } else if (esp_http_client_is_complete_data_received(client)) {
                 ESP_LOGI(TAG, "Connection closed");
-                break;
+                complete = true;
             } else {
                 ESP_LOGE(TAG, "Stream not completely read");
                 goto end;
             }
         }
 
-        // If this is the first block we've read, parse the header.
-        if (firmwareSize == 0) {
-            if (read < sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                ESP_LOGE(TAG, "Did not receive enough data to parse the firmware header");
+        filled += read;
+
+        // Parse the header once we have it.
+        if (!otaBusy) {
+            if (filled < HEADER_SIZE) {
+                if (complete) {
+                    ESP_LOGE(TAG, "Did not receive enough data to parse the firmware header");
+                    goto end;
+                }
+                continue;
+            }
+
+            if (buffer[0] != ESP_IMAGE_HEADER_MAGIC) {
+                ESP_LOGE(TAG, "Downloaded data is not a firmware image");
                 goto end;
             }
 
@@ -98,71 +344,441 @@ bool OTAManager::install_update() {
             memcpy(&newAppInfo, &buffer[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)],
                    sizeof(esp_app_desc_t));
 
-            esp_app_desc_t runningAppInfo;
-            ESP_ERROR_CHECK_JUMP(esp_ota_get_partition_description(runningPartition, &runningAppInfo), end);
+            if (!is_update(newAppInfo, runningPartition)) {
+                goto end;
+            }
 
-            ESP_LOGI(TAG, "New firmware version: %s, current %s", newAppInfo.version, runningAppInfo.version);
+            memcpy(progress.app_elf_sha256, newAppInfo.app_elf_sha256, sizeof(progress.app_elf_sha256));
+            progress.partition_address = updatePartition->address;
 
-            if (strcmp(newAppInfo.version, runningAppInfo.version) == 0) {
-                ESP_LOGI(TAG, "Firmware already up to date.");
-                goto end;
+            ESP_ERROR_CHECK_JUMP(writer.begin(updatePartition), end);
+
+            otaBusy = true;
+
+            ESP_LOGI(TAG, "Downloading new firmware");
+        }
+
+        if (filled == OTAWriter::BUFFER_SIZE || (complete && filled > 0)) {
+            ESP_ERROR_CHECK_JUMP(writer.submit(buffer, filled), end);
+
+            firmwareSize += filled;
+            filled = 0;
+
+            ESP_LOGD(TAG, "Received %d bytes", firmwareSize);
+
+            if (!complete) {
+                buffer = writer.get_buffer();
             }
+        }
+    }
 
-            auto lastInvalidApp = esp_ota_get_last_invalid_partition();
+    ESP_ERROR_CHECK_JUMP(writer.end(), end);
 
-            if (lastInvalidApp != nullptr) {
-                esp_app_desc_t invalidAppInfo;
-                ESP_ERROR_CHECK_JUMP(esp_ota_get_partition_description(lastInvalidApp, &invalidAppInfo), end);
+    otaBusy = false;
 
-                ESP_LOGI(TAG, "Last invalid firmware version: %s", invalidAppInfo.version);
+    writer.get_sha256(hash);
 
-                // Check current version with last invalid partition.
-                if (strcmp(invalidAppInfo.version, newAppInfo.version) == 0) {
-                    ESP_LOGW(TAG, "Refusing to update to invalid firmware version.");
-                    goto end;
-                }
+    err = verify_signature(hash, signature);
+    if (err == ESP_OK) {
+        // Also validates the image.
+        err = esp_ota_set_boot_partition(updatePartition);
+    }
+
+    // A rejected image would be rejected again when continued, so the next
+    // attempt starts over. The signature may also have been replaced while
+    // the image was downloaded; the next attempt gets both again.
+    if (err == ESP_OK || err == ESP_ERR_INVALID_CRC || err == ESP_ERR_OTA_VALIDATE_FAILED) {
+        clear_progress();
+    }
+
+    ESP_ERROR_CHECK_JUMP(err, end);
+
+    firmwareInstalled = true;
+
+    {
+        const auto elapsed_ms = max((int)((esp_timer_get_time() - start) / 1000), 1);
+
+        ESP_LOGI(TAG,
+                 "Installed %d bytes (resumed at %d) in %d ms (%d KB/s); flash writes took %d ms, waiting %d ms, "
+                 "hashing %d ms",
+                 firmwareSize, resumedAt, elapsed_ms, (int)((int64_t)firmwareSize * 1000 / elapsed_ms / 1024),
+                 (int)(writer.get_write_time() / 1000), (int)(writer.get_wait_time() / 1000),
+                 (int)(writer.get_hash_time() / 1000));
+    }
+
+end:
+    if (otaBusy) {
+        writer.abort();
+    }
+
+    return firmwareInstalled;
+}
+
+bool OTAManager::install_compressed_update_from_stream(esp_http_client_handle_t client,
+                                                       const esp_partition_t *updatePartition,
+                                                       const esp_partition_t *runningPartition,
+                                                       const string &signature) {
+    auto firmwareInstalled = false;
+    auto otaBusy = false;
+    auto rejected = false;
+    uint8_t header[HEADER_SIZE];
+    uint8_t hash[HASH_LENGTH];
+    size_t headerFilled = 0;
+    const auto start = esp_timer_get_time();
+    esp_err_t err;
+
+    OTAWriter writer;
+
+    // The app description is checked on the first decompressed bytes,
+    // before anything is written.
+    Inflater inflater([&](const uint8_t *data, size_t length) {
+        if (!otaBusy) {
+            const auto chunk = min(length, HEADER_SIZE - headerFilled);
+            memcpy(header + headerFilled, data, chunk);
+            headerFilled += chunk;
+            data += chunk;
+            length -= chunk;
+
+            if (headerFilled < HEADER_SIZE) {
+                return ESP_OK;
             }
 
-            ESP_ERROR_CHECK_JUMP(esp_ota_begin(updatePartition, OTA_WITH_SEQUENTIAL_WRITES, &updateHandle), end);
+            esp_app_desc_t newAppInfo;
+            if (!read_app_description(header, HEADER_SIZE, newAppInfo)) {
+                ESP_LOGE(TAG, "Decompressed data is not a firmware image");
+                return ESP_ERR_INVALID_VERSION;
+            }
+            if (!is_update(newAppInfo, runningPartition)) {
+                rejected = true;
+                return ESP_ERR_INVALID_VERSION;
+            }
+
+            auto err = writer.begin(updatePartition);
+            if (err != ESP_OK) {
+                return err;
+            }
 
             otaBusy = true;
 
+            // The partition no longer holds an interrupted download.
+            clear_progress();
+
             ESP_LOGI(TAG, "Downloading new firmware");
+
+            err = writer.write(header, HEADER_SIZE);
+            if (err != ESP_OK) {
+                return err;
+            }
         }
 
-        ESP_ERROR_CHECK_JUMP(esp_ota_write(updateHandle, (const void *)buffer, read), end);
+        return writer.write(data, length);
+    });
 
-        firmwareSize += read;
+    auto buffer = new uint8_t[READ_BUFFER_SIZE];
 
-        ESP_LOGI(TAG, "Written %d bytes, total %d", read, firmwareSize);
+    while (true) {
+        auto read = esp_http_client_read(client, (char *)buffer, READ_BUFFER_SIZE);
+
+        if (read < 0 || (read == 0 && !esp_http_client_is_complete_data_received(client))) {
+            ESP_LOGE(TAG, "Error while reading from HTTP stream, errno = %d", errno);
+            goto end;
+        }
+        if (read == 0) {
+            break;
+        }
+
+        err = inflater.write(buffer, read);
+        if (err != ESP_OK) {
+            if (!rejected) {
+                ESP_LOGE(TAG, "Failed to decompress firmware: %s", esp_err_to_name(err));
+            }
+            goto end;
+        }
     }
 
-    if (!esp_http_client_is_complete_data_received(client)) {
-        ESP_LOGE(TAG, "Stream not fully read");
+    if (!otaBusy) {
+        ESP_LOGE(TAG, "Did not receive enough data to parse the firmware header");
         goto end;
     }
 
-    ESP_ERROR_CHECK_JUMP(esp_ota_end(updateHandle), end);
+    ESP_ERROR_CHECK_JUMP(inflater.finish(), end);
+    ESP_ERROR_CHECK_JUMP(writer.end(), end);
 
     otaBusy = false;
 
+    writer.get_sha256(hash);
+
+    ESP_ERROR_CHECK_JUMP(verify_signature(hash, signature), end);
     ESP_ERROR_CHECK_JUMP(esp_ota_set_boot_partition(updatePartition), end);
 
     firmwareInstalled = true;
 
+    {
+        const auto elapsed_ms = max((int)((esp_timer_get_time() - start) / 1000), 1);
+
+        ESP_LOGI(TAG,
+                 "Installed %d bytes from %d compressed bytes in %d ms (%d KB/s); flash writes took %d ms, hashing "
+                 "%d ms",
+                 (int)inflater.get_total_out(), (int)inflater.get_total_in(), elapsed_ms,
+                 (int)((int64_t)inflater.get_total_in() * 1000 / elapsed_ms / 1024),
+                 (int)(writer.get_write_time() / 1000), (int)(writer.get_hash_time() / 1000));
+    }
+
 end:
     if (otaBusy) {
-        esp_ota_abort(updateHandle);
+        writer.abort();
     }
 
     delete[] buffer;
 
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-
     return firmwareInstalled;
 }
 
+esp_err_t OTAManager::install_delta(const esp_partition_t *updatePartition, const esp_partition_t *runningPartition,
+                                    const string &signature) {
+    esp_app_desc_t runningAppInfo;
+    auto err = esp_ota_get_partition_description(runningPartition, &runningAppInfo);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    const auto url = format(CONFIG_OTA_DELTA_ENDPOINT, runningAppInfo.version);
+
+    esp_http_client_config_t config = {
+        .url = url.c_str(),
+        .timeout_ms = CONFIG_OTA_RECV_TIMEOUT,
+    };
+
+    ESP_LOGI(TAG, "Getting firmware patch from %s", config.url);
+
+    auto result = ESP_FAIL;
+
+    err = _http_connection_manager->get(config, [&](auto client, auto length) {
+        const auto status = esp_http_client_get_status_code(client);
+        if (status == 404) {
+            result = ESP_ERR_NOT_FOUND;
+            return ESP_OK;
+        }
+        if (status != 200) {
+            ESP_LOGE(TAG, "Getting firmware patch failed with status %d", status);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        result =
+            install_delta_from_stream(client, updatePartition, runningPartition, runningAppInfo.version, signature);
+        return ESP_OK;
+    });
+
+    return err != ESP_OK ? err : result;
+}
+
+esp_err_t OTAManager::install_delta_from_stream(esp_http_client_handle_t client, const esp_partition_t *updatePartition,
+                                                const esp_partition_t *runningPartition, const char *runningVersion,
+                                                const string &signature) {
+    auto otaBusy = false;
+    auto patchSize = 0;
+    uint8_t hash[HASH_LENGTH];
+    const auto start = esp_timer_get_time();
+    esp_err_t err;
+
+    OTAWriter writer;
+    DeltaPatcher patcher(
+        [&](size_t offset, uint8_t *target, size_t length) {
+            return esp_partition_read(runningPartition, offset, target, length);
+        },
+        [&](const uint8_t *data, size_t length) { return writer.write(data, length); });
+
+    auto buffer = new uint8_t[READ_BUFFER_SIZE];
+
+    // The header is applied on its own, so nothing is written before the
+    // patch has been checked against the running firmware.
+    auto want = DeltaPatcher::HEADER_SIZE;
+
+    while (true) {
+        auto read = esp_http_client_read(client, (char *)buffer, want);
+
+        if (read < 0 || (read == 0 && !esp_http_client_is_complete_data_received(client))) {
+            ESP_LOGE(TAG, "Error while reading firmware patch, errno = %d", errno);
+            err = ESP_ERR_INVALID_RESPONSE;
+            goto end;
+        }
+        if (read == 0) {
+            break;
+        }
+
+        patchSize += read;
+
+        ESP_ERROR_CHECK_JUMP(err = patcher.write(buffer, read), end);
+
+        want = READ_BUFFER_SIZE;
+
+        if (!otaBusy && patcher.has_header()) {
+            ESP_LOGI(TAG, "Firmware patch from %s, %d to %d bytes", patcher.get_source_version(),
+                     (int)patcher.get_source_size(), (int)patcher.get_target_size());
+
+            if (strcmp(patcher.get_source_version(), runningVersion) != 0 ||
+                patcher.get_source_size() > runningPartition->size ||
+                patcher.get_target_size() > updatePartition->size) {
+                ESP_LOGE(TAG, "Firmware patch does not apply to the running firmware");
+                err = ESP_ERR_INVALID_VERSION;
+                goto end;
+            }
+
+            ESP_ERROR_CHECK_JUMP(err = writer.begin(updatePartition), end);
+
+            otaBusy = true;
+
+            // The partition no longer holds an interrupted download.
+            clear_progress();
+        } else if (!otaBusy) {
+            // Waiting for the remainder of the header.
+            want = DeltaPatcher::HEADER_SIZE - patchSize;
+        }
+    }
+
+    ESP_ERROR_CHECK_JUMP(err = patcher.finish(), end);
+
+    otaBusy = false;
+
+    ESP_ERROR_CHECK_JUMP(err = writer.end(), end);
+
+    writer.get_sha256(hash);
+    if (memcmp(hash, patcher.get_target_sha256(), HASH_LENGTH) != 0) {
+        ESP_LOGE(TAG, "Patched firmware does not match the expected hash");
+        err = ESP_ERR_INVALID_CRC;
+        goto end;
+    }
+
+    ESP_ERROR_CHECK_JUMP(err = verify_signature(hash, signature), end);
+    ESP_ERROR_CHECK_JUMP(err = esp_ota_set_boot_partition(updatePartition), end);
+
+    ESP_LOGI(TAG, "Installed %d bytes from a %d byte patch in %d ms", (int)patcher.get_target_size(), patchSize,
+             (int)((esp_timer_get_time() - start) / 1000));
+
+end:
+    if (otaBusy) {
+        writer.abort();
+    }
+
+    delete[] buffer;
+
+    return err;
+}
+
+esp_err_t OTAManager::download_signature(string &signature) {
+    if (!*CONFIG_OTA_PUBLIC_KEY) {
+        // Only builds with CONFIG_OTA_ALLOW_UNSIGNED get here.
+        ESP_LOGW(TAG, "No OTA public key configured; not verifying the firmware signature");
+        return ESP_OK;
+    }
+
+    // The signature is published next to the full image and signs the
+    // uncompressed image, so it also covers compressed and patched updates.
+    const auto url = format("%s.sig", CONFIG_OTA_ENDPOINT);
+
+    esp_http_client_config_t config = {
+        .url = url.c_str(),
+        .timeout_ms = CONFIG_OTA_RECV_TIMEOUT,
+    };
+
+    signature.clear();
+
+    auto err = _http_connection_manager->get(config, [&](auto client, auto length) {
+        const auto status = esp_http_client_get_status_code(client);
+        if (status != 200) {
+            ESP_LOGE(TAG, "Getting firmware signature failed with status %d", status);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        return HttpConnectionManager::read_string(client, signature, MAX_SIGNATURE_SIZE);
+    });
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to get firmware signature: %s", esp_err_to_name(err));
+    }
+
+    return err;
+}
+
+esp_err_t OTAManager::verify_signature(const uint8_t *hash, const string &signature) {
+    if (!*CONFIG_OTA_PUBLIC_KEY) {
+        return ESP_OK;
+    }
+
+    const auto start = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+
+    mbedtls_pk_context key;
+    mbedtls_pk_init(&key);
+
+    // The length of a PEM key includes the terminating zero.
+    auto ret = mbedtls_pk_parse_public_key(&key, (const uint8_t *)CONFIG_OTA_PUBLIC_KEY, sizeof(CONFIG_OTA_PUBLIC_KEY));
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to parse OTA public key: -0x%04x", -ret);
+        err = ESP_ERR_INVALID_ARG;
+    } else {
+        ret = mbedtls_pk_verify(&key, MBEDTLS_MD_SHA256, hash, HASH_LENGTH, (const uint8_t *)signature.data(),
+                                signature.length());
+        if (ret != 0) {
+            ESP_LOGE(TAG, "Firmware signature verification failed: -0x%04x", -ret);
+            err = ESP_ERR_INVALID_CRC;
+        }
+    }
+
+    mbedtls_pk_free(&key);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Verified firmware signature in %d ms", (int)((esp_timer_get_time() - start) / 1000));
+    }
+
+    return err;
+}
+
+bool OTAManager::load_progress(Progress &progress) {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+
+    auto length = sizeof(Progress);
+    auto err = nvs_get_blob(handle, NVS_PROGRESS_KEY, &progress, &length);
+
+    nvs_close(handle);
+
+    // The SHA-256 state is stored as is, so progress saved by a firmware
+    // with a different layout is ignored.
+    return err == ESP_OK && length == sizeof(Progress);
+}
+
+void OTAManager::save_progress(const Progress &progress) {
+    nvs_handle_t handle;
+    auto err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, NVS_PROGRESS_KEY, &progress, sizeof(Progress));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+
+        nvs_close(handle);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save OTA progress: %s", esp_err_to_name(err));
+    }
+}
+
+void OTAManager::clear_progress() {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+
+    if (nvs_erase_key(handle, NVS_PROGRESS_KEY) == ESP_OK) {
+        nvs_commit(handle);
+    }
+
+    nvs_close(handle);
+}
+
 bool OTAManager::parse_hash(char *buffer, uint8_t *hash) {
     for (auto i = 0; i < HASH_LENGTH; i++) {
         auto h = hextoi(buffer[i * 2]);
@@ -1,11 +1,23 @@
 #pragma once
 
+#include "HttpConnectionManager.h"
+
 class OTAManager {
+    // Progress of a download, saved in NVS so an interrupted download can
+    // continue where it stopped.
+    struct Progress {
+        uint8_t app_elf_sha256[32];
+        uint32_t partition_address;
+        uint32_t written;
+        mbedtls_sha256_context sha256;
+    };
+
+    HttpConnectionManager* _http_connection_manager;
     esp_timer_handle_t _update_timer;
     Callback<void> _ota_start;
 
 public:
-    OTAManager();
+    OTAManager(HttpConnectionManager* http_connection_manager);
 
     void begin();
     void on_ota_start(function<void()> func) { _ota_start.add(func); }
@@ -13,5 +25,23 @@ public:
 private:
     void update_check();
     bool install_update();
+    bool probe_update(const esp_partition_t *runningPartition, esp_app_desc_t &newAppInfo, bool &compressed);
+    bool read_app_description(const uint8_t *data, size_t length, esp_app_desc_t &appInfo);
+    bool is_update(const esp_app_desc_t &newAppInfo, const esp_partition_t *runningPartition);
+    bool install_update_from_stream(esp_http_client_handle_t client, const esp_partition_t* updatePartition,
+                                    const esp_partition_t* runningPartition, Progress& progress, bool resume,
+                                    const string& signature);
+    bool install_compressed_update_from_stream(esp_http_client_handle_t client, const esp_partition_t* updatePartition,
+                                               const esp_partition_t* runningPartition, const string& signature);
+    esp_err_t install_delta(const esp_partition_t* updatePartition, const esp_partition_t* runningPartition,
+                            const string& signature);
+    esp_err_t install_delta_from_stream(esp_http_client_handle_t client, const esp_partition_t* updatePartition,
+                                        const esp_partition_t* runningPartition, const char* runningVersion,
+                                        const string& signature);
+    esp_err_t download_signature(string& signature);
+    esp_err_t verify_signature(const uint8_t* hash, const string& signature);
+    bool load_progress(Progress& progress);
+    void save_progress(const Progress& progress);
+    void clear_progress();
     bool parse_hash(char* buffer, uint8_t* hash);
 };
@@ -0,0 +1,203 @@
+#include "includes.h"
+
+#include "OTAWriter.h"
+
+constexpr auto WRITE_TASK_STACK_SIZE = 4096;
+constexpr auto WRITE_TASK_PRIORITY = 5;
+
+static const char *TAG = "OTAWriter";
+
+OTAWriter::OTAWriter()
+    : _free(xQueueCreate(BUFFER_COUNT, sizeof(uint8_t *))),
+      _full(xQueueCreate(BUFFER_COUNT + 1, sizeof(Block))),
+      _done(xSemaphoreCreateBinary()),
+      _task(nullptr),
+      _partition(nullptr),
+      _offset(0),
+      _current(nullptr),
+      _filled(0),
+      _err(ESP_OK),
+      _write_time(0),
+      _wait_time(0),
+      _hash_time(0) {
+    for (auto &buffer : _buffers) {
+        buffer = (uint8_t *)heap_caps_malloc(BUFFER_SIZE, MALLOC_CAP_SPIRAM);
+        if (!buffer) {
+            ::abort();
+        }
+
+        xQueueSend(_free, &buffer, 0);
+    }
+
+    mbedtls_sha256_init(&_sha256);
+}
+
+OTAWriter::~OTAWriter() {
+    if (_task) {
+        abort();
+    }
+
+    for (auto buffer : _buffers) {
+        heap_caps_free(buffer);
+    }
+
+    vQueueDelete(_free);
+    vQueueDelete(_full);
+    vSemaphoreDelete(_done);
+
+    mbedtls_sha256_free(&_sha256);
+}
+
+esp_err_t OTAWriter::begin(const esp_partition_t *partition, size_t offset, const mbedtls_sha256_context *sha256) {
+    if (offset % SPI_FLASH_SEC_SIZE != 0 || offset > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    _partition = partition;
+    _offset = offset;
+
+    if (sha256) {
+        mbedtls_sha256_clone(&_sha256, sha256);
+    } else {
+        mbedtls_sha256_starts(&_sha256, 0);
+    }
+
+    xTaskCreate([](void *arg) { ((OTAWriter *)arg)->write_task(); }, "otaWrite", WRITE_TASK_STACK_SIZE, this,
+                WRITE_TASK_PRIORITY, &_task);
+
+    return ESP_OK;
+}
+
+uint8_t *OTAWriter::get_buffer() {
+    const auto start = esp_timer_get_time();
+
+    uint8_t *buffer;
+    xQueueReceive(_free, &buffer, portMAX_DELAY);
+
+    _wait_time += esp_timer_get_time() - start;
+
+    return buffer;
+}
+
+esp_err_t OTAWriter::submit(uint8_t *buffer, size_t length) {
+    Block block = {
+        .data = buffer,
+        .length = length,
+    };
+
+    xQueueSend(_full, &block, portMAX_DELAY);
+
+    return _err;
+}
+
+esp_err_t OTAWriter::write(const uint8_t *data, size_t length) {
+    while (length > 0) {
+        if (!_current) {
+            _current = get_buffer();
+            _filled = 0;
+        }
+
+        const auto chunk = min(length, BUFFER_SIZE - _filled);
+        memcpy(_current + _filled, data, chunk);
+        _filled += chunk;
+        data += chunk;
+        length -= chunk;
+
+        if (_filled == BUFFER_SIZE) {
+            auto err = submit(_current, _filled);
+            _current = nullptr;
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+
+    return _err;
+}
+
+esp_err_t OTAWriter::end() {
+    if (_current) {
+        submit(_current, _filled);
+        _current = nullptr;
+    }
+
+    stop();
+
+    return _err;
+}
+
+void OTAWriter::abort() {
+    if (_current) {
+        xQueueSend(_free, &_current, 0);
+        _current = nullptr;
+    }
+
+    stop();
+}
+
+void OTAWriter::get_sha256(uint8_t *hash) { mbedtls_sha256_finish(&_sha256, hash); }
+
+void OTAWriter::write_task() {
+    while (true) {
+        Block block;
+        xQueueReceive(_full, &block, portMAX_DELAY);
+
+        if (!block.data) {
+            break;
+        }
+
+        // After an error, buffers are only returned until the reader
+        // notices.
+        if (_err == ESP_OK) {
+            const auto start = esp_timer_get_time();
+
+            // Sectors are erased right before they're written, instead of
+            // erasing the whole partition up front.
+            const auto erase_length = (block.length + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+
+            auto err = esp_partition_erase_range(_partition, _offset, erase_length);
+            if (err == ESP_OK) {
+                err = esp_partition_write(_partition, _offset, block.data, block.length);
+            }
+
+            _write_time += esp_timer_get_time() - start;
+
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write firmware: %s", esp_err_to_name(err));
+                _err = err;
+            } else {
+                // Uses the SHA accelerator.
+                const auto hash_start = esp_timer_get_time();
+
+                mbedtls_sha256_update(&_sha256, block.data, block.length);
+
+                _hash_time += esp_timer_get_time() - hash_start;
+
+                _offset += block.length;
+
+                if (_progress) {
+                    _progress(_offset, _sha256);
+                }
+            }
+        }
+
+        xQueueSend(_free, &block.data, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(_done);
+
+    vTaskDelete(nullptr);
+}
+
+void OTAWriter::stop() {
+    if (!_task) {
+        return;
+    }
+
+    Block block = {};
+    xQueueSend(_full, &block, portMAX_DELAY);
+
+    xSemaphoreTake(_done, portMAX_DELAY);
+
+    _task = nullptr;
+}
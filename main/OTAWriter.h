@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+
+// Writes an OTA image from its own task, so flash erases and writes overlap
+// with receiving the next data. The reader takes a buffer with get_buffer(),
+// fills it and hands it over with submit(); the writer task erases and
+// writes them in order and returns them. Buffers are a multiple of the flash
+// sector size, so every write starts on a sector boundary and erases whole
+// sectors.
+//
+// The partition is written directly instead of through esp_ota_write, which
+// always starts at the beginning of the partition. That lets an interrupted
+// update continue at a sector boundary. The image is validated by
+// esp_ota_set_boot_partition.
+//
+// Alternatively, write() copies data of any length into the buffers. The
+// writer task computes the SHA-256 of everything written, so the image can
+// be verified without reading it back.
+class OTAWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 4 * SPI_FLASH_SEC_SIZE;
+
+private:
+    static constexpr int BUFFER_COUNT = 3;
+
+    struct Block {
+        uint8_t *data;
+        size_t length;
+    };
+
+    uint8_t *_buffers[BUFFER_COUNT];
+    QueueHandle_t _free;
+    QueueHandle_t _full;
+    SemaphoreHandle_t _done;
+    TaskHandle_t _task;
+    const esp_partition_t *_partition;
+    size_t _offset;
+    mbedtls_sha256_context _sha256;
+    function<void(size_t written, const mbedtls_sha256_context &sha256)> _progress;
+    uint8_t *_current;
+    size_t _filled;
+    std::atomic<esp_err_t> _err;
+    int64_t _write_time;
+    int64_t _wait_time;
+    int64_t _hash_time;
+
+public:
+    OTAWriter();
+    OTAWriter(const OTAWriter &) = delete;
+    OTAWriter &operator=(const OTAWriter &) = delete;
+    OTAWriter(OTAWriter &&) = delete;
+    OTAWriter &operator=(OTAWriter &&) = delete;
+    ~OTAWriter();
+
+    // To continue an interrupted update, pass the sector aligned offset to
+    // continue at and the SHA-256 state of the image up to there.
+    esp_err_t begin(const esp_partition_t *partition, size_t offset = 0,
+                    const mbedtls_sha256_context *sha256 = nullptr);
+
+    // Called from the writer task after every write, with the number of
+    // bytes of the image on flash and the SHA-256 state up to there.
+    void on_progress(function<void(size_t written, const mbedtls_sha256_context &sha256)> func) {
+        _progress = func;
+    }
+
+    // Blocks until the writer has a free buffer.
+    uint8_t *get_buffer();
+    // Returns the first error of the writer task, if any.
+    esp_err_t submit(uint8_t *buffer, size_t length);
+    // Copies into the buffers, submitting them as they fill up. Don't mix
+    // with get_buffer() and submit().
+    esp_err_t write(const uint8_t *data, size_t length);
+
+    // Waits for the pending writes.
+    esp_err_t end();
+    void abort();
+
+    // SHA-256 of the written image; valid after end() succeeded.
+    void get_sha256(uint8_t *hash);
+
+    // Time spent erasing and writing flash, time the reader waited for a
+    // free buffer and time spent hashing, in microseconds.
+    int64_t get_write_time() const { return _write_time; }
+    int64_t get_wait_time() const { return _wait_time; }
+    int64_t get_hash_time() const { return _hash_time; }
+
+private:
+    void write_task();
+    void stop();
+};
@@ -4,148 +4,91 @@
 
 #include "StatsDto.h"
 
+#include "JsonDecoder.h"
 #include "cJSON.h"
 
 LOG_TAG(StatsDto);
 
-static bool parse_jenkins_build_status(const char* statusStr, JenkinsBuildStatus& status) {
-    if (strcmp(statusStr, "IN_PROGRESS") == 0) {
-        status = JenkinsBuildStatus::InProgress;
-    } else if (strcmp(statusStr, "ABORTED") == 0) {
-        status = JenkinsBuildStatus::Aborted;
-    } else if (strcmp(statusStr, "FAILURE") == 0) {
-        status = JenkinsBuildStatus::Failure;
-    } else if (strcmp(statusStr, "NOT_BUILT") == 0) {
-        status = JenkinsBuildStatus::NotBuilt;
-    } else if (strcmp(statusStr, "SUCCESS") == 0) {
-        status = JenkinsBuildStatus::Success;
-    } else if (strcmp(statusStr, "UNSTABLE") == 0) {
-        status = JenkinsBuildStatus::Unstable;
-    } else {
-        ESP_LOGE(TAG, "Failed to start Jenkins build status '%s'", statusStr);
-        return false;
-    }
-
-    return true;
+// The payload comes from the network. Bound the number of elements we
+// accept so a malformed response can't blow up memory or the UI grid.
+constexpr auto MAX_ARRAY_LENGTH = 64;
+
+static constexpr JsonEnumTable JENKINS_BUILD_STATUSES = {
+    JsonEnumValue<JenkinsBuildStatus>{"IN_PROGRESS", JenkinsBuildStatus::InProgress},
+    JsonEnumValue<JenkinsBuildStatus>{"ABORTED", JenkinsBuildStatus::Aborted},
+    JsonEnumValue<JenkinsBuildStatus>{"FAILURE", JenkinsBuildStatus::Failure},
+    JsonEnumValue<JenkinsBuildStatus>{"NOT_BUILT", JenkinsBuildStatus::NotBuilt},
+    JsonEnumValue<JenkinsBuildStatus>{"SUCCESS", JenkinsBuildStatus::Success},
+    JsonEnumValue<JenkinsBuildStatus>{"UNSTABLE", JenkinsBuildStatus::Unstable},
+};
+
+static constexpr JsonFieldTable JENKINS_BUILD_FIELDS = {
+    json_field<&JenkinsBuildDto::name>("name"),
+    json_field<&JenkinsBuildDto::number>("number"),
+    json_field<&JenkinsBuildDto::execution>("execution"),
+    json_enum_field<&JenkinsBuildDto::status, &JENKINS_BUILD_STATUSES>("status"),
+};
+
+static constexpr JsonFieldTable KUBERNETES_NODE_FIELDS = {
+    json_field<&KubernetesNodeDto::name>("name"),
+    json_field<&KubernetesNodeDto::created>("created"),
+    json_field<&KubernetesNodeDto::allocated_pods>("allocated_pods"),
+    json_field<&KubernetesNodeDto::allocated_containers>("allocated_containers"),
+    json_field<&KubernetesNodeDto::cpu_capacity>("cpu_capacity"),
+    json_field<&KubernetesNodeDto::cpu_usage>("cpu_usage"),
+    json_field<&KubernetesNodeDto::memory_capacity>("memory_capacity"),
+    json_field<&KubernetesNodeDto::memory_usage>("memory_usage"),
+};
+
+static constexpr JsonFieldTable KUBERNETES_JOB_FIELDS = {
+    json_field<&KubernetesJobDto::name>("name"),
+    json_field<&KubernetesJobDto::ns>("namespace"),
+    json_field<&KubernetesJobDto::created>("created"),
+    json_nullable_field<&KubernetesJobDto::completed, &KubernetesJobDto::is_completed>("completed"),
+    json_field<&KubernetesJobDto::succeeded>("succeeded"),
+    json_field<&KubernetesJobDto::failed>("failed"),
+};
+
+static constexpr JsonFieldTable CONTAINER_STARTS_FIELDS = {
+    json_field<&ContainerStartsStatsDto::day>("day"),
+    json_field<&ContainerStartsStatsDto::week>("week"),
+};
+
+static uint16_t get_percentage(int64_t usage, int64_t capacity) {
+    if (usage <= 0) {
+        return 0;
+    }
+
+    int64_t scaled;
+    if (__builtin_mul_overflow(usage, (int64_t)100, &scaled)) {
+        return UINT16_MAX;
+    }
+
+    return (uint16_t)min(scaled / capacity, (int64_t)UINT16_MAX);
 }
 
-// Helper function to parse JenkinsBuildDto
-static bool parse_jenkins_build(const cJSON* item, JenkinsBuildDto& build) {
-    if (!cJSON_IsObject(item)) {
-        ESP_LOGE(TAG, "Jenkins build is not an object");
-        return false;
-    }
-
-    const cJSON* name = cJSON_GetObjectItemCaseSensitive(item, "name");
-    const cJSON* number = cJSON_GetObjectItemCaseSensitive(item, "number");
-    const cJSON* execution = cJSON_GetObjectItemCaseSensitive(item, "execution");
-    const cJSON* status = cJSON_GetObjectItemCaseSensitive(item, "status");
-
-    if (!cJSON_IsString(name) || !cJSON_IsNumber(number) || !cJSON_IsNumber(execution) || !cJSON_IsString(status)) {
-        ESP_LOGE(TAG, "Some parameters of Jenkins build are not found or of the expected type");
-        return false;
-    }
-
-    build.name = name->valuestring;
-    build.number = number->valueint;
-    build.execution = static_cast<time_t>(execution->valuedouble);
-    if (!parse_jenkins_build_status(status->valuestring, build.status)) {
-        return false;
-    }
-
-    return true;
+static int saturate(int64_t value) {
+    return (int)max(min(value, (int64_t)numeric_limits<int>::max()), (int64_t)numeric_limits<int>::min());
 }
 
-// Helper function to parse KubernetesNodeDto
-static bool parse_kubernetes_node(const cJSON* item, KubernetesNodeDto& node) {
-    if (!cJSON_IsObject(item)) {
-        ESP_LOGE(TAG, "Kubernetes node is not an object");
-        return false;
-    }
-
-    const cJSON* name = cJSON_GetObjectItemCaseSensitive(item, "name");
-    const cJSON* created = cJSON_GetObjectItemCaseSensitive(item, "created");
-    const cJSON* allocated_pods = cJSON_GetObjectItemCaseSensitive(item, "allocated_pods");
-    const cJSON* allocated_containers = cJSON_GetObjectItemCaseSensitive(item, "allocated_containers");
-    const cJSON* cpu_capacity = cJSON_GetObjectItemCaseSensitive(item, "cpu_capacity");
-    const cJSON* cpu_usage = cJSON_GetObjectItemCaseSensitive(item, "cpu_usage");
-    const cJSON* memory_capacity = cJSON_GetObjectItemCaseSensitive(item, "memory_capacity");
-    const cJSON* memory_usage = cJSON_GetObjectItemCaseSensitive(item, "memory_usage");
-
-    if (!cJSON_IsString(name) || !cJSON_IsNumber(created) || !cJSON_IsNumber(allocated_pods) ||
-        !cJSON_IsNumber(allocated_containers) || !cJSON_IsNumber(cpu_capacity) || !cJSON_IsNumber(cpu_usage) ||
-        !cJSON_IsNumber(memory_capacity) || !cJSON_IsNumber(memory_usage)) {
-        ESP_LOGE(TAG, "Some parameters of Kubernetes node are not found or of the expected type");
-        return false;
+template <typename T, size_t N>
+static bool decode_array(const cJSON* root, const char* name, const JsonFieldTable<T, N>& fields, vector<T>& target,
+                         JsonDecodeContext& context) {
+    const cJSON* item = cJSON_GetObjectItemCaseSensitive(root, name);
+    if (!cJSON_IsArray(item)) {
+        return true;
     }
 
-    node.name = name->valuestring;
-    node.created = static_cast<time_t>(created->valuedouble);
-    node.allocated_pods = allocated_pods->valueint;
-    node.allocated_containers = allocated_containers->valueint;
-    node.cpu_capacity = static_cast<int64_t>(cpu_capacity->valuedouble);
-    node.cpu_usage = static_cast<int64_t>(cpu_usage->valuedouble);
-    node.memory_capacity = static_cast<int64_t>(memory_capacity->valuedouble);
-    node.memory_usage = static_cast<int64_t>(memory_usage->valuedouble);
-
-    return true;
-}
+    auto mark = context.push_key(name);
 
-// Helper function to parse KubernetesJobDto
-static bool parse_kubernetes_job(const cJSON* item, KubernetesJobDto& job) {
-    if (!cJSON_IsObject(item)) {
-        ESP_LOGE(TAG, "Kubernetes job is not an object");
-        return false;
+    if (cJSON_GetArraySize(item) > MAX_ARRAY_LENGTH) {
+        return context.error("too many elements");
     }
 
-    const cJSON* name = cJSON_GetObjectItemCaseSensitive(item, "name");
-    const cJSON* ns = cJSON_GetObjectItemCaseSensitive(item, "namespace");
-    const cJSON* created = cJSON_GetObjectItemCaseSensitive(item, "created");
-    const cJSON* completed = cJSON_GetObjectItemCaseSensitive(item, "completed");
-    const cJSON* succeeded = cJSON_GetObjectItemCaseSensitive(item, "succeeded");
-    const cJSON* failed = cJSON_GetObjectItemCaseSensitive(item, "failed");
-
-    if (!cJSON_IsString(name) || !cJSON_IsString(ns) || !cJSON_IsNumber(created) ||
-        !(cJSON_IsNumber(completed) || cJSON_IsNull(completed)) || !cJSON_IsNumber(succeeded) ||
-        !cJSON_IsNumber(failed)) {
-        ESP_LOGE(TAG, "Some parameters of Kubernetes job are not found or of the expected type");
+    if (!json_decode_array(item, fields, target, context)) {
         return false;
     }
-
-    job.name = name->valuestring;
-    job.ns = ns->valuestring;
-    job.created = static_cast<time_t>(created->valuedouble);
-
-    if (cJSON_IsNumber(completed)) {
-        job.completed = static_cast<time_t>(completed->valuedouble);
-    } else {
-        job.completed = 0;
-    }
-
-    job.is_completed = cJSON_IsNumber(completed);
-    job.succeeded = succeeded->valueint;
-    job.failed = failed->valueint;
-
-    return true;
-}
-
-// Helper function to parse ContainerStartsStatsDto
-static bool parse_container_starts(const cJSON* item, ContainerStartsStatsDto& containerStarts) {
-    if (!cJSON_IsObject(item)) {
-        ESP_LOGE(TAG, "Container stats is not an object");
-        return false;
-    }
-
-    const cJSON* day = cJSON_GetObjectItemCaseSensitive(item, "day");
-    const cJSON* week = cJSON_GetObjectItemCaseSensitive(item, "week");
-
-    if (!cJSON_IsNumber(day) || !cJSON_IsNumber(week)) {
-        ESP_LOGE(TAG, "Some parameters of Container stats are not found or of the expected type");
-        return false;
-    }
-
-    containerStarts.day = day->valueint;
-    containerStarts.week = week->valueint;
+    context.pop(mark);
 
     return true;
 }
@@ -156,6 +99,22 @@ void StatsDto::clear() {
     nodes.clear();
     last_failed_jobs.clear();
     container_starts = {};
+    version = 0;
+
+    node_metrics.names.clear();
+    node_metrics.cpu_percentages.clear();
+    node_metrics.memory_percentages.clear();
+    node_metrics.cpu_labels.clear();
+    node_metrics.memory_labels.clear();
+    node_metrics.pods_labels.clear();
+    node_metrics.containers_labels.clear();
+    node_metrics.flags.clear();
+    node_metrics.total_pods = 0;
+    node_metrics.total_containers = 0;
+
+    // The vectors keep their capacity and the arena keeps its chunks, so
+    // an update of a similar size doesn't allocate.
+    strings.reset();
 }
 
 bool StatsDto::from_json(const char* json_string, StatsDto& stats) {
@@ -168,64 +127,100 @@ bool StatsDto::from_json(const char* json_string, StatsDto& stats) {
         return false;
     }
 
-    // Parse container_starts
-    const cJSON* container_starts = cJSON_GetObjectItemCaseSensitive(*root, "container_starts");
-    if (container_starts && !parse_container_starts(container_starts, stats.container_starts)) {
+    if (!cJSON_IsObject(*root)) {
+        ESP_LOGE(TAG, "Statistics are not an object");
         return false;
     }
 
-    // Parse last_builds
-    const cJSON* last_builds = cJSON_GetObjectItemCaseSensitive(*root, "last_builds");
-    if (last_builds && cJSON_IsArray(last_builds)) {
-        cJSON* build;
-        cJSON_ArrayForEach(build, last_builds) {
-            JenkinsBuildDto dto;
-            if (!parse_jenkins_build(build, dto)) {
-                return false;
-            }
-            stats.last_builds.push_back(dto);
-        }
-    }
+    JsonDecodeContext context(stats.strings);
 
-    // Parse last_failed_builds
-    const cJSON* last_failed_builds = cJSON_GetObjectItemCaseSensitive(*root, "last_failed_builds");
-    if (last_failed_builds && cJSON_IsArray(last_failed_builds)) {
-        cJSON* build;
-        cJSON_ArrayForEach(build, last_failed_builds) {
-            JenkinsBuildDto dto;
-            if (!parse_jenkins_build(build, dto)) {
-                return false;
-            }
-            stats.last_failed_builds.push_back(dto);
-        }
+    const cJSON* version = cJSON_GetObjectItemCaseSensitive(*root, "version");
+    if (cJSON_IsNumber(version)) {
+        stats.version = static_cast<int64_t>(version->valuedouble);
     }
 
-    // Parse nodes
-    const cJSON* nodes = cJSON_GetObjectItemCaseSensitive(*root, "nodes");
-    if (nodes && cJSON_IsArray(nodes)) {
-        cJSON* node;
-        cJSON_ArrayForEach(node, nodes) {
-            KubernetesNodeDto dto;
-            if (!parse_kubernetes_node(node, dto)) {
-                return false;
-            }
-            stats.nodes.push_back(dto);
+    // Arrays that are missing or of the wrong type are ignored.
+
+    const cJSON* container_starts = cJSON_GetObjectItemCaseSensitive(*root, "container_starts");
+    if (container_starts) {
+        auto mark = context.push_key("container_starts");
+        if (!json_decode_object(container_starts, CONTAINER_STARTS_FIELDS, stats.container_starts, context)) {
+            return false;
         }
+        context.pop(mark);
     }
 
-    // Parse last_failed_jobs
-    const cJSON* last_failed_jobs = cJSON_GetObjectItemCaseSensitive(*root, "last_failed_jobs");
-    if (last_failed_jobs && cJSON_IsArray(last_failed_jobs)) {
-        cJSON* job;
-        cJSON_ArrayForEach(job, last_failed_jobs) {
-            KubernetesJobDto dto;
-            if (!parse_kubernetes_job(job, dto)) {
-                return false;
-            }
-            stats.last_failed_jobs.push_back(dto);
-        }
+    if (!decode_array(*root, "last_builds", JENKINS_BUILD_FIELDS, stats.last_builds, context) ||
+        !decode_array(*root, "last_failed_builds", JENKINS_BUILD_FIELDS, stats.last_failed_builds, context) ||
+        !decode_array(*root, "nodes", KUBERNETES_NODE_FIELDS, stats.nodes, context) ||
+        !decode_array(*root, "last_failed_jobs", KUBERNETES_JOB_FIELDS, stats.last_failed_jobs, context)) {
+        return false;
     }
 
+    stats.update_node_metrics();
+
+    ESP_LOGI(TAG, "Interned %d strings (%d duplicates), arena uses %d of %d bytes", (int)stats.strings.get_count(),
+             (int)stats.strings.get_hits(), (int)stats.strings.get_used(), (int)stats.strings.get_allocated());
+
     // If all parsing steps are successful
     return true;
 }
+
+void StatsDto::update_node_metrics() {
+    auto& metrics = node_metrics;
+    const auto count = nodes.size();
+
+    metrics.names.resize(count);
+    metrics.cpu_percentages.resize(count);
+    metrics.memory_percentages.resize(count);
+    metrics.cpu_labels.resize(count);
+    metrics.memory_labels.resize(count);
+    metrics.pods_labels.resize(count);
+    metrics.containers_labels.resize(count);
+    metrics.flags.resize(count);
+
+    // Summed wide, as the payload may hold values that overflow an int.
+    int64_t total_pods = 0;
+    int64_t total_containers = 0;
+
+    char buffer[16];
+
+    for (size_t i = 0; i < count; i++) {
+        auto& node = nodes[i];
+        uint8_t flags = 0;
+
+        metrics.names[i] = node.name;
+
+        if (node.cpu_capacity > 0) {
+            metrics.cpu_percentages[i] = get_percentage(node.cpu_usage, node.cpu_capacity);
+            snprintf(buffer, sizeof(buffer), "%d%%", (int)metrics.cpu_percentages[i]);
+            metrics.cpu_labels[i] = strings.intern(buffer);
+        } else {
+            flags |= NODE_CPU_UNKNOWN;
+            metrics.cpu_percentages[i] = 0;
+            metrics.cpu_labels[i] = "-";
+        }
+
+        if (node.memory_capacity > 0) {
+            metrics.memory_percentages[i] = get_percentage(node.memory_usage, node.memory_capacity);
+            snprintf(buffer, sizeof(buffer), "%d%%", (int)metrics.memory_percentages[i]);
+            metrics.memory_labels[i] = strings.intern(buffer);
+        } else {
+            flags |= NODE_MEMORY_UNKNOWN;
+            metrics.memory_percentages[i] = 0;
+            metrics.memory_labels[i] = "-";
+        }
+
+        snprintf(buffer, sizeof(buffer), "%d", node.allocated_pods);
+        metrics.pods_labels[i] = strings.intern(buffer);
+        snprintf(buffer, sizeof(buffer), "%d", node.allocated_containers);
+        metrics.containers_labels[i] = strings.intern(buffer);
+
+        metrics.flags[i] = flags;
+        total_pods += node.allocated_pods;
+        total_containers += node.allocated_containers;
+    }
+
+    metrics.total_pods = saturate(total_pods);
+    metrics.total_containers = saturate(total_containers);
+}
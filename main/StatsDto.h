@@ -1,16 +1,21 @@
 #pragma once
 
+#include "StringArena.h"
+
 enum class JenkinsBuildStatus : int8_t { InProgress, Aborted, Failure, NotBuilt, Success, Unstable };
 
+// String members point into StatsDto::strings and are valid until the
+// next update.
+
 struct JenkinsBuildDto {
-    string name;
+    const char* name;
     int number;
     time_t execution;
     JenkinsBuildStatus status;
 };
 
 struct KubernetesNodeDto {
-    string name;
+    const char* name;
     time_t created;
     int allocated_pods;
     int allocated_containers;
@@ -21,8 +26,8 @@ struct KubernetesNodeDto {
 };
 
 struct KubernetesJobDto {
-    string name;
-    string ns;
+    const char* name;
+    const char* ns;
     time_t created;
     time_t completed;
     bool is_completed;
@@ -35,14 +40,42 @@ struct ContainerStartsStatsDto {
     int week;
 };
 
+enum NodeMetricsFlags : uint8_t {
+    NODE_CPU_UNKNOWN = 1 << 0,
+    NODE_MEMORY_UNKNOWN = 1 << 1,
+};
+
+// Values derived from StatsDto::nodes, one column per value and one row per
+// node. Computed once per update so rendering only reads them. Percentages
+// are zero and labels are "-" when the capacity is unknown.
+struct NodeMetricsDto {
+    vector<const char*> names;
+    vector<uint16_t> cpu_percentages;
+    vector<uint16_t> memory_percentages;
+    vector<const char*> cpu_labels;
+    vector<const char*> memory_labels;
+    vector<const char*> pods_labels;
+    vector<const char*> containers_labels;
+    vector<uint8_t> flags;
+    int total_pods;
+    int total_containers;
+
+    size_t size() const { return names.size(); }
+};
+
 struct StatsDto {
     vector<JenkinsBuildDto> last_builds;
     vector<JenkinsBuildDto> last_failed_builds;
     vector<KubernetesNodeDto> nodes;
     vector<KubernetesJobDto> last_failed_jobs;
     ContainerStartsStatsDto container_starts;
+    NodeMetricsDto node_metrics;
+    // Version of the statistics, as reported by the push endpoint. Zero
+    // when the server doesn't provide one.
+    int64_t version;
+    StringArena strings;
 
-    StatsDto() {}
+    StatsDto() : container_starts(), node_metrics(), version(0) {}
     StatsDto(const StatsDto&) = delete;
     StatsDto& operator=(const StatsDto&) = delete;
     StatsDto(StatsDto&&) = delete;
@@ -50,5 +83,9 @@ struct StatsDto {
 
     void clear();
 
+    // Recomputes node_metrics from nodes. Called by from_json; call it after
+    // filling nodes by hand.
+    void update_node_metrics();
+
     static bool from_json(const char* json_string, StatsDto& stats);
 };
@@ -0,0 +1,312 @@
+#include "includes.h"
+
+#ifndef LV_SIMULATOR
+
+#include "StatsSnapshot.h"
+
+#include "esp_rom_crc.h"
+
+LOG_TAG(StatsSnapshot);
+
+constexpr auto PARTITION_LABEL = "stats";
+constexpr auto SLOT_COUNT = 2;
+
+namespace {
+
+class SnapshotWriter {
+    string& _buffer;
+
+public:
+    SnapshotWriter(string& buffer) : _buffer(buffer) {}
+
+    template <typename T>
+    void write(T value) {
+        _buffer.append((const char*)&value, sizeof(value));
+    }
+
+    void write_string(const char* value) {
+        auto length = (uint16_t)min(strlen(value), (size_t)UINT16_MAX);
+        write(length);
+        _buffer.append(value, length);
+    }
+};
+
+class SnapshotReader {
+    const uint8_t* _data;
+    size_t _length;
+    size_t _offset;
+    bool _failed;
+
+public:
+    SnapshotReader(const uint8_t* data, size_t length) : _data(data), _length(length), _offset(0), _failed(false) {}
+
+    bool failed() const { return _failed; }
+
+    template <typename T>
+    T read() {
+        T value = {};
+        if (_offset + sizeof(T) > _length) {
+            _failed = true;
+            return value;
+        }
+        memcpy(&value, _data + _offset, sizeof(T));
+        _offset += sizeof(T);
+        return value;
+    }
+
+    const char* read_string(StringArena& strings) {
+        auto length = read<uint16_t>();
+        if (_failed || _offset + length > _length) {
+            _failed = true;
+            return "";
+        }
+        auto result = strings.intern((const char*)_data + _offset, length);
+        _offset += length;
+        return result;
+    }
+};
+
+}  // namespace
+
+bool StatsSnapshot::save(const StatsDto& stats) {
+    auto partition = get_partition();
+    if (!partition) {
+        return false;
+    }
+
+    string payload;
+    serialize(stats, payload);
+
+    const auto slot_size = partition->size / SLOT_COUNT;
+    if (sizeof(Header) + payload.length() > slot_size) {
+        ESP_LOGW(TAG, "Snapshot of %d bytes doesn't fit in the partition", (int)payload.length());
+        return false;
+    }
+
+    Header latest;
+    auto latest_slot = find_latest_slot(partition, latest);
+
+    const auto slot = latest_slot < 0 ? 0 : (latest_slot + 1) % SLOT_COUNT;
+    const auto offset = slot * slot_size;
+
+    Header header = {
+        .magic = MAGIC,
+        .version = VERSION,
+        .sequence = latest_slot < 0 ? 1 : latest.sequence + 1,
+        .length = (uint32_t)payload.length(),
+        .crc = esp_rom_crc32_le(0, (const uint8_t*)payload.data(), payload.length()),
+    };
+
+    const auto erase_size = (sizeof(Header) + payload.length() + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+
+    ESP_ERROR_CHECK_JUMP(esp_partition_erase_range(partition, offset, erase_size), fail);
+    ESP_ERROR_CHECK_JUMP(
+        esp_partition_write(partition, offset + sizeof(Header), payload.data(), payload.length()), fail);
+    ESP_ERROR_CHECK_JUMP(esp_partition_write(partition, offset, &header, sizeof(header)), fail);
+
+    ESP_LOGI(TAG, "Saved snapshot of %d bytes to slot %d", (int)payload.length(), slot);
+
+    return true;
+
+fail:
+    return false;
+}
+
+bool StatsSnapshot::load(StatsDto& stats) {
+    auto partition = get_partition();
+    if (!partition) {
+        return false;
+    }
+
+    Header header;
+    auto slot = find_latest_slot(partition, header);
+    if (slot < 0) {
+        ESP_LOGI(TAG, "No snapshot available");
+        return false;
+    }
+
+    auto data = (uint8_t*)heap_caps_malloc(header.length, MALLOC_CAP_SPIRAM);
+    if (!data) {
+        return false;
+    }
+
+    auto result = false;
+    const auto offset = slot * (partition->size / SLOT_COUNT) + sizeof(Header);
+
+    ESP_ERROR_CHECK_JUMP(esp_partition_read(partition, offset, data, header.length), end);
+
+    if (esp_rom_crc32_le(0, data, header.length) != header.crc) {
+        ESP_LOGW(TAG, "Snapshot in slot %d has an invalid checksum", slot);
+        goto end;
+    }
+
+    result = deserialize(data, header.length, stats);
+
+    if (result) {
+        ESP_LOGI(TAG, "Loaded snapshot of %d bytes from slot %d", (int)header.length, slot);
+    } else {
+        ESP_LOGW(TAG, "Failed to deserialize snapshot");
+        stats.clear();
+    }
+
+end:
+    heap_caps_free(data);
+
+    return result;
+}
+
+const esp_partition_t* StatsSnapshot::get_partition() {
+    auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, PARTITION_LABEL);
+    if (!partition) {
+        ESP_LOGW(TAG, "Partition %s not found", PARTITION_LABEL);
+    }
+    return partition;
+}
+
+int StatsSnapshot::find_latest_slot(const esp_partition_t* partition, Header& header) {
+    const auto slot_size = partition->size / SLOT_COUNT;
+    auto latest = -1;
+
+    for (auto slot = 0; slot < SLOT_COUNT; slot++) {
+        Header candidate;
+        if (esp_partition_read(partition, slot * slot_size, &candidate, sizeof(candidate)) != ESP_OK) {
+            continue;
+        }
+
+        if (candidate.magic != MAGIC || candidate.version != VERSION ||
+            candidate.length > slot_size - sizeof(Header)) {
+            continue;
+        }
+
+        if (latest >= 0 && candidate.sequence <= header.sequence) {
+            continue;
+        }
+
+        // A slot whose write was torn must not hide the other slot.
+        if (!check_crc(partition, slot * slot_size + sizeof(Header), candidate)) {
+            ESP_LOGW(TAG, "Snapshot in slot %d has an invalid checksum", slot);
+            continue;
+        }
+
+        header = candidate;
+        latest = slot;
+    }
+
+    return latest;
+}
+
+bool StatsSnapshot::check_crc(const esp_partition_t* partition, size_t offset, const Header& header) {
+    uint8_t buffer[256];
+    uint32_t crc = 0;
+
+    for (size_t read = 0; read < header.length;) {
+        const auto chunk = min(sizeof(buffer), (size_t)header.length - read);
+
+        if (esp_partition_read(partition, offset + read, buffer, chunk) != ESP_OK) {
+            return false;
+        }
+
+        crc = esp_rom_crc32_le(crc, buffer, chunk);
+        read += chunk;
+    }
+
+    return crc == header.crc;
+}
+
+void StatsSnapshot::serialize(const StatsDto& stats, string& buffer) {
+    SnapshotWriter writer(buffer);
+
+    writer.write((int32_t)stats.container_starts.day);
+    writer.write((int32_t)stats.container_starts.week);
+
+    for (auto builds : {&stats.last_builds, &stats.last_failed_builds}) {
+        writer.write((uint16_t)builds->size());
+        for (auto& build : *builds) {
+            writer.write_string(build.name);
+            writer.write((int32_t)build.number);
+            writer.write((int64_t)build.execution);
+            writer.write((int8_t)build.status);
+        }
+    }
+
+    writer.write((uint16_t)stats.nodes.size());
+    for (auto& node : stats.nodes) {
+        writer.write_string(node.name);
+        writer.write((int64_t)node.created);
+        writer.write((int32_t)node.allocated_pods);
+        writer.write((int32_t)node.allocated_containers);
+        writer.write(node.cpu_capacity);
+        writer.write(node.cpu_usage);
+        writer.write(node.memory_capacity);
+        writer.write(node.memory_usage);
+    }
+
+    writer.write((uint16_t)stats.last_failed_jobs.size());
+    for (auto& job : stats.last_failed_jobs) {
+        writer.write_string(job.name);
+        writer.write_string(job.ns);
+        writer.write((int64_t)job.created);
+        writer.write((int64_t)job.completed);
+        writer.write((uint8_t)job.is_completed);
+        writer.write((int32_t)job.succeeded);
+        writer.write((int32_t)job.failed);
+    }
+}
+
+bool StatsSnapshot::deserialize(const uint8_t* data, size_t length, StatsDto& stats) {
+    stats.clear();
+
+    SnapshotReader reader(data, length);
+
+    stats.container_starts.day = reader.read<int32_t>();
+    stats.container_starts.week = reader.read<int32_t>();
+
+    for (auto builds : {&stats.last_builds, &stats.last_failed_builds}) {
+        auto count = reader.read<uint16_t>();
+        for (auto i = 0; i < count && !reader.failed(); i++) {
+            JenkinsBuildDto build;
+            build.name = reader.read_string(stats.strings);
+            build.number = reader.read<int32_t>();
+            build.execution = (time_t)reader.read<int64_t>();
+            build.status = (JenkinsBuildStatus)reader.read<int8_t>();
+            builds->push_back(build);
+        }
+    }
+
+    auto node_count = reader.read<uint16_t>();
+    for (auto i = 0; i < node_count && !reader.failed(); i++) {
+        KubernetesNodeDto node;
+        node.name = reader.read_string(stats.strings);
+        node.created = (time_t)reader.read<int64_t>();
+        node.allocated_pods = reader.read<int32_t>();
+        node.allocated_containers = reader.read<int32_t>();
+        node.cpu_capacity = reader.read<int64_t>();
+        node.cpu_usage = reader.read<int64_t>();
+        node.memory_capacity = reader.read<int64_t>();
+        node.memory_usage = reader.read<int64_t>();
+        stats.nodes.push_back(node);
+    }
+
+    auto job_count = reader.read<uint16_t>();
+    for (auto i = 0; i < job_count && !reader.failed(); i++) {
+        KubernetesJobDto job;
+        job.name = reader.read_string(stats.strings);
+        job.ns = reader.read_string(stats.strings);
+        job.created = (time_t)reader.read<int64_t>();
+        job.completed = (time_t)reader.read<int64_t>();
+        job.is_completed = reader.read<uint8_t>() != 0;
+        job.succeeded = reader.read<int32_t>();
+        job.failed = reader.read<int32_t>();
+        stats.last_failed_jobs.push_back(job);
+    }
+
+    if (reader.failed()) {
+        return false;
+    }
+
+    stats.update_node_metrics();
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#ifndef LV_SIMULATOR
+
+#include "StatsDto.h"
+
+// Persists the last successfully parsed statistics in the "stats" flash
+// partition so they can be shown immediately after a restart.
+//
+// The partition is split into two slots that are written alternately. A
+// slot starts with a header holding a sequence number and a CRC of the
+// payload; the header is written last, so a torn write leaves the other
+// slot intact. The latest slot whose payload matches its CRC is used, so a
+// torn write falls back to the previous snapshot.
+class StatsSnapshot {
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t sequence;
+        uint32_t length;
+        uint32_t crc;
+    };
+
+    static constexpr uint32_t MAGIC = 0x53534e53;  // "SNSS"
+    static constexpr uint32_t VERSION = 1;
+
+public:
+    static bool save(const StatsDto& stats);
+    static bool load(StatsDto& stats);
+
+private:
+    static const esp_partition_t* get_partition();
+    static int find_latest_slot(const esp_partition_t* partition, Header& header);
+    static bool check_crc(const esp_partition_t* partition, size_t offset, const Header& header);
+    static void serialize(const StatsDto& stats, string& buffer);
+    static bool deserialize(const uint8_t* data, size_t length, StatsDto& stats);
+};
+
+#endif
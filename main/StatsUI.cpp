@@ -6,71 +6,267 @@
 #include <ctime>
 
 #include "Messages.h"
+#include "StatsSnapshot.h"
 #include "lv_support.h"
 
+#ifndef LV_SIMULATOR
+#include "esp_random.h"
+#endif
+
 LOG_TAG(StatsUI);
 
-void StatsUI::do_begin() { LvglUI::do_begin(); }
+#ifndef LV_SIMULATOR
+constexpr auto FETCH_TASK_STACK_SIZE = 8192;
+constexpr auto FETCH_TASK_PRIORITY = 1;
+constexpr auto PUSH_ENABLED = sizeof(CONFIG_INFRA_STATISTICS_PUSH_ENDPOINT) > 1;
+constexpr auto PUSH_RETRY_DELAY_MS = 10000;
+
+StatsUI::StatsUI(HttpConnectionManager* http_connection_manager)
+    : _http_connection_manager(http_connection_manager),
+      _scheduler(
+          {
+              .interval = CONFIG_INFRA_STATISTICS_UPDATE_INTERVAL,
+              .active_interval = CONFIG_INFRA_STATISTICS_ACTIVE_UPDATE_INTERVAL,
+              .quiet_interval = CONFIG_INFRA_STATISTICS_QUIET_UPDATE_INTERVAL,
+              .quiet_start_hour = CONFIG_INFRA_STATISTICS_QUIET_START_HOUR,
+              .quiet_end_hour = CONFIG_INFRA_STATISTICS_QUIET_END_HOUR,
+              .retry_min = CONFIG_INFRA_STATISTICS_RETRY_INTERVAL,
+              .retry_max = CONFIG_INFRA_STATISTICS_UPDATE_INTERVAL,
+          },
+          esp_random()),
+      _push_active(PUSH_ENABLED) {}
+
+#endif
+
+void StatsUI::do_begin() {
+    LvglUI::do_begin();
+
+#ifndef LV_SIMULATOR
+    xTaskCreate([](void* arg) { ((StatsUI*)arg)->fetch_task(); }, "statsFetch", FETCH_TASK_STACK_SIZE, this,
+                FETCH_TASK_PRIORITY, &_fetch_task);
+#endif
+}
 
 #ifndef LV_SIMULATOR
 
 void StatsUI::do_update() {
-    auto current_time = time(nullptr);
-
-    if (_next_update == 0 || current_time >= _next_update) {
-        if (_next_update == 0) {
-            // Get the time_t for the start of the hour.
-            auto start_hour_time_info = *localtime(&current_time);
-            start_hour_time_info.tm_min = 0;
-            start_hour_time_info.tm_sec = 0;
-            auto start_hour_time = mktime(&start_hour_time_info);
-
-            // Calculate the number of seconds from the current time to
-            // the next update interval.
-            auto diff = current_time - start_hour_time;
-            auto rounded_up =
-                ((diff + CONFIG_INFRA_STATISTICS_UPDATE_INTERVAL - 1) / CONFIG_INFRA_STATISTICS_UPDATE_INTERVAL) *
-                CONFIG_INFRA_STATISTICS_UPDATE_INTERVAL;
-
-            // Set the next update to the correct time. After the initial
-            // calculation, every other update will be calculated simply
-            // by adding the update interval.
-            _next_update = start_hour_time + rounded_up;
-
-            // Subtract 10 seconds to better time the update on the interval.
-            // The update completes in roughly 15 seconds.
-            _next_update -= 10;
-        } else {
-            _next_update += CONFIG_INFRA_STATISTICS_UPDATE_INTERVAL;
+    if (_fetch_state == FetchState::Failed) {
+        _fetch_state = FetchState::Idle;
+        _scheduler.failed(time(nullptr));
+    }
+
+    if (_fetch_state == FetchState::Ready) {
+        auto start = esp_timer_get_time();
+
+        swap(_stats, _pending_stats);
+        _fetch_state = FetchState::Idle;
+        _stale = false;
+        _node_history.record(_stats->node_metrics);
+
+        ESP_LOGI(TAG, "Updating screen");
+
+        render();
+
+        const auto render_ms = (int)((esp_timer_get_time() - start) / 1000);
+
+        ESP_LOGI(TAG, "Swapping and rendering statistics stalled the main loop for %d ms", render_ms);
+
+        if (!_push_active) {
+            _scheduler.succeeded(time(nullptr), _fetch_duration_ms + render_ms, is_changing(*_stats, *_pending_stats));
         }
 
-        update_stats();
+        if (!_have_rendered_fresh) {
+            _have_rendered_fresh = true;
+
+            ESP_LOGI(TAG, "First up to date statistics rendered %d ms after boot", (int)(start / 1000));
+        }
+    }
+
+    // With a push endpoint the fetch task schedules itself.
+    if (_push_active) {
+        return;
+    }
+
+    // Network I/O happens on the fetch task. Don't schedule a new fetch
+    // while the previous one hasn't been picked up yet.
+    if (_fetch_state != FetchState::Idle) {
+        return;
+    }
+
+    if (_scheduler.is_due(time(nullptr))) {
+        _fetch_state = FetchState::Fetching;
+        xTaskNotifyGive(_fetch_task);
     }
 }
 
-void StatsUI::update_stats() {
+void StatsUI::fetch_task() {
+    if (_push_active) {
+        // Returns when the server turns out not to support pushing.
+        push_loop();
+    }
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        auto start = esp_timer_get_time();
+
+        bool modified;
+        auto success = fetch_stats(CONFIG_INFRA_STATISTICS_ENDPOINT, CONFIG_INFRA_STATISTICS_ENDPOINT_RECV_TIMEOUT,
+                                   *_pending_stats, modified);
+
+        _fetch_duration_ms = (int)((esp_timer_get_time() - start) / 1000);
+
+        ESP_LOGI(TAG, "Fetching statistics took %d ms on the fetch task", _fetch_duration_ms);
+
+        hand_off(success && modified);
+    }
+}
+
+void StatsUI::push_loop() {
+    const auto endpoint = CONFIG_INFRA_STATISTICS_PUSH_ENDPOINT;
+    const auto separator = strchr(endpoint, '?') ? '&' : '?';
+
+    int64_t version = 0;
+    int64_t next_hand_off = 0;
+
+    while (true) {
+        // Coalesce updates: wait for the UI to pick up the previous result
+        // and for the minimum refresh spacing to pass. Changes made in the
+        // meantime are folded into the next long-poll response.
+        while (_fetch_state != FetchState::Idle || esp_timer_get_time() < next_hand_off) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+
+        // The first request goes without a version so the server responds
+        // immediately.
+        auto url = version ? format("%s%cversion=%lld", endpoint, separator, (long long)version) : string(endpoint);
+
+        _fetch_state = FetchState::Fetching;
+
+        bool modified;
+        if (!fetch_stats(url.c_str(), CONFIG_INFRA_STATISTICS_PUSH_RECV_TIMEOUT, *_pending_stats, modified)) {
+            _fetch_state = FetchState::Idle;
+            vTaskDelay(pdMS_TO_TICKS(PUSH_RETRY_DELAY_MS));
+            continue;
+        }
+
+        if (!modified) {
+            _fetch_state = FetchState::Idle;
+            continue;
+        }
+
+        version = _pending_stats->version;
+        if (!version) {
+            // Without a version every long-poll returns immediately. Hand
+            // off what we have and let the scheduler take over.
+            ESP_LOGW(TAG, "Push endpoint didn't return a version; falling back to polling");
+
+            _push_active = false;
+            hand_off(true);
+            return;
+        }
+
+        next_hand_off = esp_timer_get_time() + ESP_TIMER_SECONDS(CONFIG_INFRA_STATISTICS_MIN_REFRESH_INTERVAL);
+
+        hand_off(true);
+    }
+}
+
+void StatsUI::hand_off(bool success) {
+    if (success) {
+        StatsSnapshot::save(*_pending_stats);
+    }
+
+    _fetch_state = success ? FetchState::Ready : FetchState::Failed;
+}
+
+bool StatsUI::is_changing(const StatsDto& current, const StatsDto& previous) {
+    for (auto& build : current.last_builds) {
+        if (build.status == JenkinsBuildStatus::InProgress) {
+            return true;
+        }
+    }
+
+    // Nothing to compare against on the first update.
+    if (previous.last_builds.empty() && previous.last_failed_jobs.empty()) {
+        return false;
+    }
+
+    auto newest_build = [](const StatsDto& stats) {
+        return stats.last_builds.empty() ? 0 : stats.last_builds[0].number;
+    };
+    auto newest_job = [](const StatsDto& stats) {
+        return stats.last_failed_jobs.empty() ? 0 : stats.last_failed_jobs[0].created;
+    };
+
+    return newest_build(current) != newest_build(previous) || newest_job(current) != newest_job(previous);
+}
+
+bool StatsUI::load_snapshot() {
+    if (!StatsSnapshot::load(*_stats)) {
+        return false;
+    }
+
+    _stale = true;
+
+    ESP_LOGI(TAG, "Rendering snapshot %d ms after boot", (int)(esp_timer_get_time() / 1000));
+
+    render();
+
+    return true;
+}
+
+bool StatsUI::fetch_stats(const char* url, int timeout_ms, StatsDto& stats, bool& modified) {
     esp_http_client_config_t config = {
-        .url = CONFIG_INFRA_STATISTICS_ENDPOINT,
-        .timeout_ms = CONFIG_INFRA_STATISTICS_ENDPOINT_RECV_TIMEOUT,
+        .url = url,
+        .timeout_ms = timeout_ms,
     };
 
     ESP_LOGI(TAG, "Downloading statistics from %s", config.url);
 
     string json;
-    auto err = esp_http_download_string(config, json, 128 * 1024);
+    auto status = 0;
+
+    auto err = _http_connection_manager->get(config, [&json, &status](auto client, auto length) {
+        status = esp_http_client_get_status_code(client);
+
+        // The push endpoint reports that nothing changed with a 304.
+        if (status == 304) {
+            return esp_http_client_flush_response(client, nullptr);
+        }
+        if (status < 200 || status >= 300) {
+            ESP_LOGE(TAG, "Downloading statistics failed with status %d", status);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        return HttpConnectionManager::read_string(client, json, 128 * 1024);
+    });
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to download statistics");
-        return;
+        return false;
     }
 
-    if (!StatsDto::from_json(json.c_str(), _stats)) {
+    modified = status != 304;
+    if (!modified) {
+        ESP_LOGI(TAG, "Statistics not modified");
+        return true;
+    }
+
+    const auto free_before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    const auto parse_start = esp_timer_get_time();
+
+    if (!StatsDto::from_json(json.c_str(), stats)) {
         ESP_LOGE(TAG, "Failed to parse JSON");
-        return;
+        return false;
     }
 
-    ESP_LOGI(TAG, "Updating screen");
+    ESP_LOGI(TAG, "Parsed %d bytes in %d us, free internal heap changed by %d bytes", (int)json.length(),
+             (int)(esp_timer_get_time() - parse_start),
+             (int)heap_caps_get_free_size(MALLOC_CAP_INTERNAL) - (int)free_before);
 
-    render();
+    _http_connection_manager->log_statistics();
+
+    return true;
 }
 
 #endif
@@ -83,6 +279,10 @@ void StatsUI::do_render(lv_obj_t* parent) {
                                                LV_GRID_CONTENT, LV_GRID_FR(1),   LV_GRID_TEMPLATE_LAST};
     lv_obj_set_grid_dsc_array(outer_cont, outer_cont_col_desc, outer_cont_row_desc);
 
+    if (_stale) {
+        create_stale_notice(outer_cont, 0, 0);
+    }
+
     create_statistics(outer_cont, 0, 1);
     create_kubernetes_nodes(outer_cont, 0, 2);
 
@@ -97,8 +297,18 @@ void StatsUI::do_render(lv_obj_t* parent) {
     create_failed_jobs(bottom_outer_cont, 1, 0);
 }
 
+void StatsUI::create_stale_notice(lv_obj_t* parent, uint8_t col, uint8_t row) {
+    auto label = lv_label_create(parent);
+    lv_label_set_text(label, MSG_STALE);
+    lv_obj_set_style_text_font(label, SMALL_FONT, LV_PART_MAIN);
+    lv_obj_set_grid_cell(label, LV_GRID_ALIGN_END, col, LV_GRID_ALIGN_START, row);
+}
+
 void StatsUI::create_kubernetes_nodes(lv_obj_t* parent, uint8_t col, uint8_t row) {
-    auto node_count = _stats.nodes.size();
+    auto node_count = _stats->node_metrics.size();
+    if (node_count == 0) {
+        return;
+    }
 
     auto nodes_cont = lv_obj_create(parent);
     reset_layout_container_styles(nodes_cont);
@@ -116,12 +326,18 @@ void StatsUI::create_kubernetes_nodes(lv_obj_t* parent, uint8_t col, uint8_t row
     lv_obj_set_style_pad_top(nodes_cont, lv_dpx(10), LV_PART_MAIN);
     lv_obj_set_style_pad_bottom(nodes_cont, lv_dpx(18), LV_PART_MAIN);
 
+    // The canvases of the previous render are gone by now.
+    _sparkline_buffers.clear();
+    _sparkline_buffers.reserve(node_count);
+
     for (size_t i = 0; i < node_count; i++) {
-        create_kubernetes_node(nodes_cont, _stats.nodes[i], i * 2, 0);
+        create_kubernetes_node(nodes_cont, i, i * 2, 0);
     }
 }
 
-void StatsUI::create_kubernetes_node(lv_obj_t* parent, KubernetesNodeDto& node, uint8_t col, uint8_t row) {
+void StatsUI::create_kubernetes_node(lv_obj_t* parent, size_t index, uint8_t col, uint8_t row) {
+    auto& metrics = _stats->node_metrics;
+
     auto circle_cont = lv_obj_create(parent);
     reset_layout_container_styles(circle_cont);
     lv_obj_set_grid_cell(circle_cont, LV_GRID_ALIGN_CENTER, col, LV_GRID_ALIGN_START, row);
@@ -137,7 +353,7 @@ void StatsUI::create_kubernetes_node(lv_obj_t* parent, KubernetesNodeDto& node,
 
     auto name_label = lv_label_create(circle_cont);
     lv_obj_set_grid_cell(name_label, LV_GRID_ALIGN_CENTER, 0, LV_GRID_ALIGN_START, 1);
-    lv_label_set_text(name_label, node.name.c_str());
+    lv_label_set_text_static(name_label, metrics.names[index]);
     lv_obj_set_style_text_font(name_label, SMALL_FONT, LV_PART_MAIN);
 
     auto resources_row = lv_obj_create(circle_cont);
@@ -155,7 +371,7 @@ void StatsUI::create_kubernetes_node(lv_obj_t* parent, KubernetesNodeDto& node,
     lv_obj_set_grid_cell(cpu_icon_label, LV_GRID_ALIGN_START, 0, LV_GRID_ALIGN_CENTER, 0);
 
     auto cpu_label = lv_label_create(resources_row);
-    lv_label_set_text(cpu_label, format("%d%%", (int)(node.cpu_usage * 100.0f / node.cpu_capacity)).c_str());
+    lv_label_set_text_static(cpu_label, metrics.cpu_labels[index]);
     lv_obj_set_style_text_font(cpu_label, SMALL_FONT, LV_PART_MAIN);
     lv_obj_set_style_pad_hor(cpu_label, lv_dpx(5), LV_PART_MAIN);
     lv_obj_set_grid_cell(cpu_label, LV_GRID_ALIGN_START, 1, LV_GRID_ALIGN_CENTER, 0);
@@ -167,7 +383,7 @@ void StatsUI::create_kubernetes_node(lv_obj_t* parent, KubernetesNodeDto& node,
     lv_obj_set_grid_cell(memory_icon_label, LV_GRID_ALIGN_START, 2, LV_GRID_ALIGN_CENTER, 0);
 
     auto memory_label = lv_label_create(resources_row);
-    lv_label_set_text(memory_label, format("%d%%", (int)(node.memory_usage * 100.0f / node.memory_capacity)).c_str());
+    lv_label_set_text_static(memory_label, metrics.memory_labels[index]);
     lv_obj_set_style_text_font(memory_label, SMALL_FONT, LV_PART_MAIN);
     lv_obj_set_style_pad_hor(memory_label, lv_dpx(5), LV_PART_MAIN);
     lv_obj_set_grid_cell(memory_label, LV_GRID_ALIGN_START, 3, LV_GRID_ALIGN_CENTER, 0);
@@ -186,7 +402,7 @@ void StatsUI::create_kubernetes_node(lv_obj_t* parent, KubernetesNodeDto& node,
     lv_obj_set_grid_cell(pods_icon_label, LV_GRID_ALIGN_START, 0, LV_GRID_ALIGN_CENTER, 0);
 
     auto pods_label = lv_label_create(containers_row);
-    lv_label_set_text(pods_label, format("%d", node.allocated_pods).c_str());
+    lv_label_set_text_static(pods_label, metrics.pods_labels[index]);
     lv_obj_set_style_text_font(pods_label, SMALL_FONT, LV_PART_MAIN);
     lv_obj_set_style_pad_hor(pods_label, lv_dpx(5), LV_PART_MAIN);
     lv_obj_set_grid_cell(pods_label, LV_GRID_ALIGN_START, 1, LV_GRID_ALIGN_CENTER, 0);
@@ -198,10 +414,51 @@ void StatsUI::create_kubernetes_node(lv_obj_t* parent, KubernetesNodeDto& node,
     lv_obj_set_grid_cell(containers_icon_label, LV_GRID_ALIGN_START, 2, LV_GRID_ALIGN_CENTER, 0);
 
     auto containers_label = lv_label_create(containers_row);
-    lv_label_set_text(containers_label, format("%d", node.allocated_containers).c_str());
+    lv_label_set_text_static(containers_label, metrics.containers_labels[index]);
     lv_obj_set_style_text_font(containers_label, SMALL_FONT, LV_PART_MAIN);
     lv_obj_set_style_pad_hor(containers_label, lv_dpx(5), LV_PART_MAIN);
     lv_obj_set_grid_cell(containers_label, LV_GRID_ALIGN_START, 3, LV_GRID_ALIGN_CENTER, 0);
+
+    create_sparkline(circle_cont, metrics.names[index], 0, 4);
+}
+
+void StatsUI::create_sparkline(lv_obj_t* parent, const char* name, uint8_t col, uint8_t row) {
+    uint8_t cpu[NodeHistory::SAMPLES];
+    uint8_t memory[NodeHistory::SAMPLES];
+    auto count = _node_history.get_samples(name, cpu, memory);
+    if (count < 2) {
+        return;
+    }
+
+    const auto width = lv_dpx(110);
+    const auto height = lv_dpx(30);
+
+    // Draw straight into a 1bpp canvas; two palette entries precede the
+    // pixel data.
+    _sparkline_buffers.emplace_back(LV_CANVAS_BUF_SIZE_INDEXED_1BIT(width, height));
+    auto& buffer = _sparkline_buffers.back();
+    auto bits = buffer.data() + 4 * 2;
+
+    // Newest sample on the right edge; CPU is solid, memory dashed.
+    auto x = [&](int i) {
+        return (lv_coord_t)((NodeHistory::SAMPLES - count + i) * (width - 1) / (NodeHistory::SAMPLES - 1));
+    };
+    auto y = [&](uint8_t value) { return (lv_coord_t)((height - 1) - value * (height - 1) / 100); };
+
+    for (auto i = 1; i < count; i++) {
+        if (cpu[i - 1] != NodeHistory::NO_SAMPLE && cpu[i] != NodeHistory::NO_SAMPLE) {
+            lv_1bpp_draw_line(bits, width, height, x(i - 1), y(cpu[i - 1]), x(i), y(cpu[i]), 0);
+        }
+        if (memory[i - 1] != NodeHistory::NO_SAMPLE && memory[i] != NodeHistory::NO_SAMPLE) {
+            lv_1bpp_draw_line(bits, width, height, x(i - 1), y(memory[i - 1]), x(i), y(memory[i]), 2);
+        }
+    }
+
+    auto canvas = lv_canvas_create(parent);
+    lv_canvas_set_buffer(canvas, buffer.data(), width, height, LV_IMG_CF_INDEXED_1BIT);
+    lv_canvas_set_palette(canvas, 0, lv_color_white());
+    lv_canvas_set_palette(canvas, 1, lv_color_black());
+    lv_obj_set_grid_cell(canvas, LV_GRID_ALIGN_CENTER, col, LV_GRID_ALIGN_START, row);
 }
 
 void StatsUI::create_statistics(lv_obj_t* parent, uint8_t col, uint8_t row) {
@@ -213,18 +470,10 @@ void StatsUI::create_statistics(lv_obj_t* parent, uint8_t col, uint8_t row) {
     static lv_coord_t cont_row_desc[] = {LV_GRID_CONTENT, LV_GRID_TEMPLATE_LAST};
     lv_obj_set_grid_dsc_array(cont, cont_col_desc, cont_row_desc);
 
-    auto total_containers = 0;
-    auto total_pods = 0;
-
-    for (auto& node : _stats.nodes) {
-        total_containers += node.allocated_containers;
-        total_pods += node.allocated_pods;
-    }
-
-    create_container_starts_cell(cont, total_pods, FA_CUBES, 1, 0);
-    create_container_starts_cell(cont, total_containers, FA_CUBE, 3, 0);
-    create_container_starts_cell(cont, _stats.container_starts.week, FA_CALENDAR_WEEK, 4, 0);
-    create_container_starts_cell(cont, _stats.container_starts.day, FA_CALENDAR_DAY, 5, 0);
+    create_container_starts_cell(cont, _stats->node_metrics.total_pods, FA_CUBES, 1, 0);
+    create_container_starts_cell(cont, _stats->node_metrics.total_containers, FA_CUBE, 3, 0);
+    create_container_starts_cell(cont, _stats->container_starts.week, FA_CALENDAR_WEEK, 4, 0);
+    create_container_starts_cell(cont, _stats->container_starts.day, FA_CALENDAR_DAY, 5, 0);
 }
 
 void StatsUI::create_container_starts_cell(lv_obj_t* parent, int value, const char* icon, uint8_t col, uint8_t row) {
@@ -251,10 +500,10 @@ void StatsUI::create_container_starts_cell(lv_obj_t* parent, int value, const ch
 void StatsUI::create_last_builds(lv_obj_t* parent, uint8_t col, uint8_t row) {
     vector<Job> jobs;
 
-    jobs.reserve(_stats.last_builds.size());
+    jobs.reserve(_stats->last_builds.size());
 
-    for (auto& build : _stats.last_builds) {
-        jobs.emplace_back(FA_GEARS, nullptr, move(format("#%d %s", build.number, build.name.c_str())), build.execution);
+    for (auto& build : _stats->last_builds) {
+        jobs.emplace_back(FA_GEARS, nullptr, move(format("#%d %s", build.number, build.name)), build.execution);
     }
 
     create_jobs(parent, jobs, col, row);
@@ -263,16 +512,16 @@ void StatsUI::create_last_builds(lv_obj_t* parent, uint8_t col, uint8_t row) {
 void StatsUI::create_failed_jobs(lv_obj_t* parent, uint8_t col, uint8_t row) {
     vector<Job> jobs;
 
-    jobs.reserve(_stats.last_failed_builds.size() + _stats.last_failed_jobs.size());
+    jobs.reserve(_stats->last_failed_builds.size() + _stats->last_failed_jobs.size());
 
-    for (auto& build : _stats.last_failed_builds) {
-        jobs.emplace_back(FA_GEARS, FA_CIRCLE_EXCLAMATION, move(format("#%d %s", build.number, build.name.c_str())),
+    for (auto& build : _stats->last_failed_builds) {
+        jobs.emplace_back(FA_GEARS, FA_CIRCLE_EXCLAMATION, move(format("#%d %s", build.number, build.name)),
                           build.execution);
     }
 
-    for (auto& job : _stats.last_failed_jobs) {
+    for (auto& job : _stats->last_failed_jobs) {
         jobs.emplace_back(FA_CIRCLE_PLAY, FA_CIRCLE_EXCLAMATION,
-                          move(format("%s (%s)", job.name.c_str(), job.ns.c_str())), job.created);
+                          move(format("%s (%s)", job.name, job.ns)), job.created);
     }
 
     sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.time > b.time; });
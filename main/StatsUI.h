@@ -1,7 +1,14 @@
 ﻿#pragma once
 
 #include "Device.h"
+#ifndef LV_SIMULATOR
+#include <atomic>
+
+#include "HttpConnectionManager.h"
+#include "UpdateScheduler.h"
+#endif
 #include "LvglUI.h"
+#include "NodeHistory.h"
 #include "StatsDto.h"
 
 class StatsUI : public LvglUI {
@@ -15,14 +22,37 @@ class StatsUI : public LvglUI {
         time_t time;
     };
 
-    StatsDto _stats;
 #ifndef LV_SIMULATOR
-    time_t _next_update = 0;
+    enum class FetchState { Idle, Fetching, Ready, Failed };
+#endif
+
+    // The fetch task parses into _pending_stats while _stats is being
+    // displayed. The buffers are swapped on the main loop.
+    StatsDto _stats_buffers[2];
+    StatsDto* _stats = &_stats_buffers[0];
+    bool _stale = false;
+    NodeHistory _node_history;
+    vector<vector<uint8_t>> _sparkline_buffers;
+#ifndef LV_SIMULATOR
+    StatsDto* _pending_stats = &_stats_buffers[1];
+    HttpConnectionManager* _http_connection_manager;
+    TaskHandle_t _fetch_task = nullptr;
+    std::atomic<FetchState> _fetch_state = FetchState::Idle;
+    int _fetch_duration_ms = 0;
+    UpdateScheduler _scheduler;
+    // Cleared by the fetch task when the push endpoint doesn't support
+    // versions; the scheduler drives polling from then on.
+    std::atomic<bool> _push_active;
+    bool _have_rendered_fresh = false;
 #endif
 
 public:
 #ifdef LV_SIMULATOR
-    StatsDto& get_stats() { return _stats; }
+    StatsDto& get_stats() { return *_stats; }
+#else
+    StatsUI(HttpConnectionManager* http_connection_manager);
+
+    bool load_snapshot();
 #endif
 
 protected:
@@ -31,11 +61,17 @@ protected:
 
 #ifndef LV_SIMULATOR
     void do_update() override;
-    void update_stats();
+    void fetch_task();
+    void push_loop();
+    void hand_off(bool success);
+    bool fetch_stats(const char* url, int timeout_ms, StatsDto& stats, bool& modified);
+    static bool is_changing(const StatsDto& current, const StatsDto& previous);
 #endif
 
+    void create_stale_notice(lv_obj_t* parent, uint8_t col, uint8_t row);
     void create_kubernetes_nodes(lv_obj_t* parent, uint8_t col, uint8_t row);
-    void create_kubernetes_node(lv_obj_t* parent, KubernetesNodeDto& node, uint8_t col, uint8_t row);
+    void create_kubernetes_node(lv_obj_t* parent, size_t index, uint8_t col, uint8_t row);
+    void create_sparkline(lv_obj_t* parent, const char* name, uint8_t col, uint8_t row);
     void create_statistics(lv_obj_t* parent, uint8_t col, uint8_t row);
     void create_container_starts_cell(lv_obj_t* parent, int value, const char* icon, uint8_t col, uint8_t row);
     void create_last_builds(lv_obj_t* parent, uint8_t col, uint8_t row);
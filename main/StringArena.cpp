@@ -0,0 +1,143 @@
+#include "includes.h"
+
+#include "StringArena.h"
+
+StringArena::StringArena() : _chunks(nullptr), _current(nullptr), _count(0), _hits(0) {}
+
+StringArena::~StringArena() {
+    while (_chunks) {
+        auto chunk = _chunks;
+        _chunks = chunk->next;
+#ifdef LV_SIMULATOR
+        free(chunk);
+#else
+        heap_caps_free(chunk);
+#endif
+    }
+}
+
+const char* StringArena::intern(const char* value, size_t length) {
+    if (_table.empty()) {
+        _table.resize(INITIAL_TABLE_SIZE);
+    }
+
+    const auto mask = _table.size() - 1;
+    auto index = hash(value, length) & mask;
+
+    while (_table[index]) {
+        if (strncmp(_table[index], value, length) == 0 && _table[index][length] == 0) {
+            _hits++;
+            return _table[index];
+        }
+        index = (index + 1) & mask;
+    }
+
+    auto result = allocate(length + 1);
+    memcpy(result, value, length);
+    result[length] = 0;
+
+    _table[index] = result;
+    _count++;
+
+    // Keep the load factor under a half.
+    if (_count * 2 >= _table.size()) {
+        grow_table();
+    }
+
+    return result;
+}
+
+void StringArena::reset() {
+    for (auto chunk = _chunks; chunk; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+
+    _current = _chunks;
+
+    fill(_table.begin(), _table.end(), nullptr);
+    _count = 0;
+    _hits = 0;
+}
+
+size_t StringArena::get_used() const {
+    size_t used = 0;
+    for (auto chunk = _chunks; chunk; chunk = chunk->next) {
+        used += chunk->used;
+    }
+    return used;
+}
+
+size_t StringArena::get_allocated() const {
+    size_t allocated = 0;
+    for (auto chunk = _chunks; chunk; chunk = chunk->next) {
+        allocated += chunk->size;
+    }
+    return allocated;
+}
+
+char* StringArena::allocate(size_t size) {
+    while (_current && _current->size - _current->used < size) {
+        _current = _current->next;
+    }
+
+    if (!_current) {
+        const auto chunkSize = max(size, CHUNK_SIZE);
+
+#ifdef LV_SIMULATOR
+        auto chunk = (Chunk*)malloc(sizeof(Chunk) + chunkSize);
+#else
+        auto chunk = (Chunk*)heap_caps_malloc(sizeof(Chunk) + chunkSize, MALLOC_CAP_SPIRAM);
+#endif
+        if (!chunk) {
+            abort();
+        }
+
+        chunk->size = chunkSize;
+        chunk->used = 0;
+
+        // Append the chunk so earlier, partially filled chunks are
+        // visited first after a reset.
+        chunk->next = nullptr;
+        if (!_chunks) {
+            _chunks = chunk;
+        } else {
+            auto last = _chunks;
+            while (last->next) {
+                last = last->next;
+            }
+            last->next = chunk;
+        }
+
+        _current = chunk;
+    }
+
+    auto result = _current->data + _current->used;
+    _current->used += size;
+    return result;
+}
+
+void StringArena::grow_table() {
+    vector<const char*> table(_table.size() * 2);
+    const auto mask = table.size() - 1;
+
+    for (auto value : _table) {
+        if (value) {
+            auto index = hash(value, strlen(value)) & mask;
+            while (table[index]) {
+                index = (index + 1) & mask;
+            }
+            table[index] = value;
+        }
+    }
+
+    _table.swap(table);
+}
+
+uint32_t StringArena::hash(const char* value, size_t length) {
+    // FNV-1a.
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)value[i]) * 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+// Bump allocator for strings with an intern table. Strings live until
+// reset() is called; reset() keeps the allocated chunks so steady state
+// updates don't allocate at all. Chunks are allocated from PSRAM.
+class StringArena {
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+        size_t used;
+        char data[];
+    };
+
+    static constexpr size_t CHUNK_SIZE = 4096;
+    static constexpr size_t INITIAL_TABLE_SIZE = 64;
+
+    Chunk* _chunks;
+    Chunk* _current;
+    vector<const char*> _table;
+    size_t _count;
+    size_t _hits;
+
+public:
+    StringArena();
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+    StringArena(StringArena&&) = delete;
+    StringArena& operator=(StringArena&&) = delete;
+    ~StringArena();
+
+    // Returns a copy of value owned by the arena. Equal strings share the
+    // same copy.
+    const char* intern(const char* value) { return intern(value, strlen(value)); }
+    const char* intern(const char* value, size_t length);
+    void reset();
+
+    size_t get_count() const { return _count; }
+    size_t get_hits() const { return _hits; }
+    size_t get_used() const;
+    size_t get_allocated() const;
+
+private:
+    char* allocate(size_t size);
+    void grow_table();
+    static uint32_t hash(const char* value, size_t length);
+};
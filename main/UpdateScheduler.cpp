@@ -0,0 +1,83 @@
+#include "includes.h"
+
+#include "UpdateScheduler.h"
+
+LOG_TAG(UpdateScheduler);
+
+UpdateScheduler::UpdateScheduler(const Config& config, uint32_t seed)
+    : _config(config), _next_update(0), _duration_ms(INITIAL_DURATION_MS), _failures(0), _random(seed | 1) {}
+
+void UpdateScheduler::succeeded(time_t now, int duration_ms, bool active) {
+    // Exponential moving average so a single slow fetch doesn't throw off
+    // the timing.
+    _duration_ms = (_duration_ms * 3 + duration_ms) / 4;
+    _failures = 0;
+
+    const auto interval = get_interval(now, active);
+    _next_update = get_aligned(now, interval);
+
+    ESP_LOGI(TAG, "Update took %d ms (average %d ms), next update in %d s at a %d s interval%s", duration_ms,
+             _duration_ms, (int)(_next_update - now), (int)interval, active ? " (data is changing)" : "");
+}
+
+void UpdateScheduler::failed(time_t now) {
+    auto delay = _config.retry_min;
+    for (auto i = 0; i < _failures && delay < _config.retry_max; i++) {
+        delay *= 2;
+    }
+    delay = min(delay, _config.retry_max);
+
+    // Jitter between 75% and 125% so devices don't retry in lock step.
+    delay = delay * (75 + (time_t)(next_random() % 51)) / 100;
+
+    _failures++;
+    _next_update = now + max(delay, (time_t)1);
+
+    ESP_LOGW(TAG, "Update failed %d time(s) in a row, retrying in %d s", _failures, (int)(_next_update - now));
+}
+
+time_t UpdateScheduler::get_interval(time_t now, bool active) const {
+    tm time_info;
+    localtime_r(&now, &time_info);
+
+    const auto start = _config.quiet_start_hour;
+    const auto end = _config.quiet_end_hour;
+    const auto hour = time_info.tm_hour;
+
+    const auto quiet = start <= end ? hour >= start && hour < end : hour >= start || hour < end;
+
+    if (quiet) {
+        return _config.quiet_interval;
+    }
+    if (active) {
+        return _config.active_interval;
+    }
+    return _config.interval;
+}
+
+time_t UpdateScheduler::get_aligned(time_t now, time_t interval) const {
+    tm time_info;
+    localtime_r(&now, &time_info);
+    time_info.tm_hour = 0;
+    time_info.tm_min = 0;
+    time_info.tm_sec = 0;
+    const auto midnight = mktime(&time_info);
+
+    // Start early by the time an update takes, so the screen changes on
+    // the slot boundary.
+    const auto lead = (time_t)((_duration_ms + 999) / 1000);
+
+    // The first slot whose start is still ahead of us.
+    const auto elapsed = now + lead - midnight;
+    auto slot = midnight + (elapsed / interval + 1) * interval;
+
+    return slot - lead;
+}
+
+uint32_t UpdateScheduler::next_random() {
+    // xorshift32; deterministic for a given seed.
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return _random;
+}
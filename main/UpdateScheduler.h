@@ -0,0 +1,50 @@
+#pragma once
+
+// Decides when the statistics should be fetched next.
+//
+// Updates are aligned on multiples of the interval counted from local
+// midnight, and start early by the learned fetch and render duration so
+// the screen changes on the slot boundary. The interval shortens while the
+// data is changing and lengthens during quiet hours. Failures are retried
+// with jittered exponential backoff.
+//
+// The scheduler doesn't read the clock itself; every call takes the current
+// time so it can be driven by a fake clock.
+class UpdateScheduler {
+public:
+    struct Config {
+        time_t interval;
+        time_t active_interval;
+        time_t quiet_interval;
+        int quiet_start_hour;
+        int quiet_end_hour;
+        time_t retry_min;
+        time_t retry_max;
+    };
+
+private:
+    static constexpr int INITIAL_DURATION_MS = 10000;
+
+    Config _config;
+    time_t _next_update;
+    int _duration_ms;
+    int _failures;
+    uint32_t _random;
+
+public:
+    UpdateScheduler(const Config& config, uint32_t seed);
+
+    bool is_due(time_t now) const { return _next_update == 0 || now >= _next_update; }
+    time_t get_next_update() const { return _next_update; }
+    int get_duration_ms() const { return _duration_ms; }
+
+    // Reports a successful update. duration_ms covers fetching and rendering;
+    // active tells whether the data is changing.
+    void succeeded(time_t now, int duration_ms, bool active);
+    void failed(time_t now);
+
+private:
+    time_t get_interval(time_t now, bool active) const;
+    time_t get_aligned(time_t now, time_t interval) const;
+    uint32_t next_random();
+};
@@ -48,6 +48,8 @@ using namespace std;
 #include "freertos/task.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
 #include "mqtt_client.h"
 #include "nvs_flash.h"
 #include "sdkconfig.h"
@@ -73,7 +75,9 @@ static T clamp(T value, T min, T max) {
 
 #ifdef LV_SIMULATOR
 
+#ifndef ESP_LOGE
 #define ESP_LOGE(...)
+#endif
 
 #else
 
@@ -35,3 +35,38 @@ void lv_obj_set_bounds(lv_obj_t* obj, lv_coord_t x, lv_coord_t y, lv_coord_t wid
 
     lv_obj_set_y(obj, y - height / 2);
 }
+
+// Draws a line into the pixel data of an LV_IMG_CF_INDEXED_1BIT image
+// (after the palette) by setting bits to 1. A dash length of 0 draws a
+// solid line.
+void lv_1bpp_draw_line(uint8_t* bits, lv_coord_t width, lv_coord_t height, lv_coord_t x0, lv_coord_t y0,
+                       lv_coord_t x1, lv_coord_t y1, uint8_t dash) {
+    const auto stride = (width + 7) / 8;
+
+    // Bresenham.
+    const auto dx = abs(x1 - x0);
+    const auto dy = -abs(y1 - y0);
+    const auto sx = x0 < x1 ? 1 : -1;
+    const auto sy = y0 < y1 ? 1 : -1;
+    auto err = dx + dy;
+
+    for (auto step = 0;; step++) {
+        if ((!dash || (step / dash) % 2 == 0) && x0 >= 0 && x0 < width && y0 >= 0 && y0 < height) {
+            bits[y0 * stride + (x0 >> 3)] |= 0x80 >> (x0 & 7);
+        }
+
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+
+        auto e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
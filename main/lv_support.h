@@ -6,3 +6,5 @@ void lv_obj_set_grid_cell(lv_obj_t* obj, lv_grid_align_t x_align, uint8_t col_po
                           uint8_t row_pos);
 void lv_obj_set_bounds(lv_obj_t* obj, lv_coord_t x, lv_coord_t y, lv_coord_t width, lv_coord_t height,
                        lv_text_align_t align);
+void lv_1bpp_draw_line(uint8_t* bits, lv_coord_t width, lv_coord_t height, lv_coord_t x0, lv_coord_t y0,
+                       lv_coord_t x1, lv_coord_t y1, uint8_t dash);
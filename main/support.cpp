@@ -84,71 +84,6 @@ int hextoi(char c) {
 
 #ifndef LV_SIMULATOR
 
-esp_err_t esp_http_download_string(const esp_http_client_config_t& config, string& target, size_t maxLength) {
-    target.clear();
-
-    constexpr size_t BUFFER_SIZE = 1024;
-    const auto bufferSize = maxLength > 0 ? min(maxLength + 1, BUFFER_SIZE) : BUFFER_SIZE;
-
-    auto buffer = new char[bufferSize];
-    auto err = ESP_OK;
-    int64_t length = 0;
-
-    auto client = esp_http_client_init(&config);
-
-    if ((err = esp_http_client_open(client, 0)) != ESP_OK) {
-        goto end;
-    }
-
-    length = esp_http_client_fetch_headers(client);
-    if (length < 0) {
-        err = -length;
-        goto end;
-    }
-
-    while (true) {
-        auto read = esp_http_client_read(client, buffer, bufferSize);
-        if (read < 0) {
-            err = -read;
-            goto end;
-        }
-        if (read == 0) {
-            break;
-        }
-
-        if (maxLength > 0 && target.length() + read > maxLength) {
-            err = ESP_ERR_INVALID_SIZE;
-            goto end;
-        }
-
-        target.append(buffer, read);
-    }
-
-end:
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-
-    delete[] buffer;
-
-    return err;
-}
-
-esp_err_t esp_http_upload_string(const esp_http_client_config_t& config, const char* const data) {
-    auto err = ESP_OK;
-
-    auto client = esp_http_client_init(&config);
-
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_post_field(client, data, strlen(data));
-
-    err = esp_http_client_perform(client);
-
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-
-    return err;
-}
-
 char const* esp_reset_reason_to_name(esp_reset_reason_t reason) {
     switch (reason) {
         case ESP_RST_POWERON:
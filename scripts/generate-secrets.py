@@ -1,13 +1,17 @@
 import os
 import sys
 
-env_vars = ["WIFI_PASSWORD"]
+# OTA_PUBLIC_KEY is the PEM public key OTA images are verified with. It isn't
+# secret, but like the WiFi password it's provided by the build environment.
+# The firmware doesn't build without it, unless CONFIG_OTA_ALLOW_UNSIGNED is
+# set.
+env_vars = ["WIFI_PASSWORD", "OTA_PUBLIC_KEY"]
 
 content = "#pragma once\n\n"
 
 for var in env_vars:
     value = os.getenv(var, "")
-    value = value.replace("\\", "\\\\")
+    value = value.replace("\\", "\\\\").replace('"', '\\"').replace("\r", "").replace("\n", "\\n")
     content += f'#define CONFIG_{var} "{value}"\n'
 
 current_content = ""
@@ -0,0 +1,163 @@
+import hashlib
+import struct
+import sys
+
+# Creates and applies delta patches for OTA updates, in the format
+# DeltaPatcher applies on the device.
+#
+#   python scripts/ota-delta.py create <source.bin> <target.bin> <patch>
+#   python scripts/ota-delta.py apply <source.bin> <patch> <target.bin>
+#
+# The patch is published at CONFIG_OTA_DELTA_ENDPOINT with the version of
+# source.bin filled in. create applies the patch it wrote to check it.
+
+MAGIC = b"OTAD"
+VERSION_OFFSET = 24 + 8 + 16  # Image header, segment header, esp_app_desc_t fields
+VERSION_SIZE = 32
+HEADER_FORMAT = "<4s32sII32s"
+
+OPCODE_END = 0
+OPCODE_COPY = 1
+OPCODE_INSERT = 2
+
+KEY_SIZE = 12
+MIN_COPY = 24
+
+
+def get_version(image):
+    return image[VERSION_OFFSET : VERSION_OFFSET + VERSION_SIZE]
+
+
+def match_length(a, ai, b, bi, limit):
+    n = 0
+    while n < limit:
+        step = min(256, limit - n)
+        if a[ai + n : ai + n + step] == b[bi + n : bi + n + step]:
+            n += step
+            continue
+        while n < limit and a[ai + n] == b[bi + n]:
+            n += 1
+        break
+    return n
+
+
+def create(source, target):
+    # Source positions are indexed at four byte steps, which is the
+    # alignment of most of an image. Any longer match still contains an
+    # indexed position and is extended in both directions from there.
+    index = {}
+    for p in range(0, len(source) - KEY_SIZE + 1, 4):
+        index.setdefault(source[p : p + KEY_SIZE], p)
+
+    commands = []
+    literal_start = 0
+    i = 0
+
+    def flush_literal(end):
+        if end > literal_start:
+            data = target[literal_start:end]
+            commands.append(struct.pack("<BI", OPCODE_INSERT, len(data)) + data)
+
+    while i <= len(target) - KEY_SIZE:
+        p = index.get(target[i : i + KEY_SIZE])
+        if p is None:
+            i += 1
+            continue
+
+        forward = match_length(target, i, source, p, min(len(target) - i, len(source) - p))
+
+        backward = 0
+        while (
+            i - backward > literal_start
+            and p - backward > 0
+            and target[i - backward - 1] == source[p - backward - 1]
+        ):
+            backward += 1
+
+        if forward + backward < MIN_COPY:
+            i += 1
+            continue
+
+        flush_literal(i - backward)
+        commands.append(struct.pack("<BII", OPCODE_COPY, p - backward, forward + backward))
+
+        i += forward
+        literal_start = i
+
+    flush_literal(len(target))
+    commands.append(struct.pack("<B", OPCODE_END))
+
+    header = struct.pack(
+        HEADER_FORMAT,
+        MAGIC,
+        get_version(source),
+        len(source),
+        len(target),
+        hashlib.sha256(target).digest(),
+    )
+
+    return header + b"".join(commands)
+
+
+def apply(source, patch):
+    magic, version, source_size, target_size, target_sha256 = struct.unpack_from(HEADER_FORMAT, patch)
+    if magic != MAGIC:
+        raise ValueError("Not a delta patch")
+    if version != get_version(source) or source_size != len(source):
+        raise ValueError("Patch doesn't apply to this source")
+
+    target = bytearray()
+    offset = struct.calcsize(HEADER_FORMAT)
+
+    while True:
+        opcode = patch[offset]
+        offset += 1
+
+        if opcode == OPCODE_END:
+            break
+        elif opcode == OPCODE_COPY:
+            start, length = struct.unpack_from("<II", patch, offset)
+            offset += 8
+            target += source[start : start + length]
+        elif opcode == OPCODE_INSERT:
+            (length,) = struct.unpack_from("<I", patch, offset)
+            offset += 4
+            target += patch[offset : offset + length]
+            offset += length
+        else:
+            raise ValueError(f"Invalid opcode {opcode}")
+
+    if len(target) != target_size or hashlib.sha256(target).digest() != target_sha256:
+        raise ValueError("Patched image doesn't match")
+
+    return bytes(target)
+
+
+def read(path):
+    with open(path, "rb") as file:
+        return file.read()
+
+
+def write(path, data):
+    with open(path, "wb") as file:
+        file.write(data)
+
+
+if len(sys.argv) != 5 or sys.argv[1] not in ("create", "apply"):
+    print(f"usage: {sys.argv[0]} create <source> <target> <patch>", file=sys.stderr)
+    print(f"       {sys.argv[0]} apply <source> <patch> <target>", file=sys.stderr)
+    sys.exit(2)
+
+if sys.argv[1] == "create":
+    source = read(sys.argv[2])
+    target = read(sys.argv[3])
+    patch = create(source, target)
+
+    if apply(source, patch) != target:
+        raise ValueError("Patch doesn't reproduce the target")
+
+    write(sys.argv[4], patch)
+
+    print(f"Patch is {len(patch)} bytes, {len(patch) * 100 // max(len(target), 1)}% of the target")
+else:
+    write(sys.argv[4], apply(read(sys.argv[2]), read(sys.argv[3])))
@@ -0,0 +1,91 @@
+import os
+import random
+import re
+import socket
+import sys
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import unquote, urlparse
+
+# Local stand-in for the OTA asset server that drops connections.
+#
+#   python scripts/ota-server.py <directory> [port] [disconnect after bytes]
+#
+# GET /<name> returns the file from the directory, honoring Range requests.
+# Responses larger than the disconnect threshold are cut off after a random
+# number of bytes between half and one and a half times the threshold, so
+# the device has to resume the download. Point CONFIG_OTA_ENDPOINT (and
+# CONFIG_OTA_DELTA_ENDPOINT) at this server to test against it.
+
+CHUNK_SIZE = 4096
+
+directory = sys.argv[1]
+port = int(sys.argv[2]) if len(sys.argv) > 2 else 8080
+disconnect_after = int(sys.argv[3]) if len(sys.argv) > 3 else 256 * 1024
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_GET(self):
+        name = os.path.basename(unquote(urlparse(self.path).path))
+        path = os.path.join(directory, name)
+
+        if not name or not os.path.isfile(path):
+            self.send_error(404)
+            return
+
+        size = os.path.getsize(path)
+        start, end = 0, size - 1
+        status = 200
+
+        range_header = self.headers.get("Range")
+        if range_header:
+            match = re.fullmatch(r"bytes=(\d+)-(\d*)", range_header.strip())
+            if not match or int(match[1]) >= size:
+                self.send_response(416)
+                self.send_header("Content-Range", f"bytes */{size}")
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+
+            start = int(match[1])
+            end = min(int(match[2]), size - 1) if match[2] else size - 1
+            status = 206
+
+        length = end - start + 1
+
+        self.send_response(status)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(length))
+        if status == 206:
+            self.send_header("Content-Range", f"bytes {start}-{end}/{size}")
+        self.end_headers()
+
+        limit = length
+        if length > disconnect_after:
+            limit = random.randint(disconnect_after // 2, disconnect_after * 3 // 2)
+
+        with open(path, "rb") as f:
+            f.seek(start)
+            sent = 0
+
+            while sent < length:
+                data = f.read(min(CHUNK_SIZE, length - sent))
+
+                if sent + len(data) > limit:
+                    self.wfile.write(data[: limit - sent])
+                    self.wfile.flush()
+                    print(f"Dropping connection after {start + limit} of {size} bytes of {name}")
+                    self.connection.shutdown(socket.SHUT_RDWR)
+                    self.close_connection = True
+                    return
+
+                self.wfile.write(data)
+                sent += len(data)
+
+        print(f"Sent bytes {start}-{end} of {name}")
+
+
+print(f"Serving {directory} on port {port}, dropping connections after about {disconnect_after} bytes")
+
+ThreadingHTTPServer(("", port), Handler).serve_forever()
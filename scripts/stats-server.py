@@ -0,0 +1,167 @@
+import json
+import random
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+# Local stand-in for the statistics service.
+#
+#   python scripts/stats-server.py [port] [change interval in seconds]
+#
+# GET /stats returns the current statistics. GET /stats/push?version=N holds
+# the request until the statistics are newer than version N and returns 304
+# when nothing changed within the hold time. Point
+# CONFIG_INFRA_STATISTICS_ENDPOINT or CONFIG_INFRA_STATISTICS_PUSH_ENDPOINT
+# at this server to test against it.
+
+HOLD_TIME = 60
+
+port = int(sys.argv[1]) if len(sys.argv) > 1 else 8080
+change_interval = float(sys.argv[2]) if len(sys.argv) > 2 else 30
+
+condition = threading.Condition()
+version = 1
+build_number = 100
+now = int(time.time())
+
+builds = []
+failed_builds = []
+failed_jobs = []
+
+nodes = [
+    {
+        "name": f"node-{i}",
+        "created": now - 86400 * (30 + i),
+        "allocated_pods": 20,
+        "allocated_containers": 40,
+        "cpu_capacity": 8000,
+        "cpu_usage": 2000,
+        "memory_capacity": 32 * 1024 * 1024 * 1024,
+        "memory_usage": 12 * 1024 * 1024 * 1024,
+    }
+    for i in range(1, 4)
+]
+
+container_starts = {"day": 120, "week": 840}
+
+
+def add_build():
+    global build_number
+
+    build_number += 1
+    build = {
+        "name": random.choice(["backend", "frontend", "infra", "docs"]),
+        "number": build_number,
+        "execution": int(time.time()),
+        "status": random.choice(["SUCCESS", "SUCCESS", "SUCCESS", "FAILURE", "UNSTABLE", "IN_PROGRESS"]),
+    }
+
+    builds.insert(0, build)
+    del builds[10:]
+
+    if build["status"] in ("FAILURE", "UNSTABLE"):
+        failed_builds.insert(0, build)
+        del failed_builds[5:]
+
+
+def add_failed_job():
+    created = int(time.time()) - random.randint(60, 3600)
+    completed = random.choice([None, created + random.randint(10, 60)])
+
+    failed_jobs.insert(
+        0,
+        {
+            "name": f"cleanup-{random.randint(1000, 9999)}",
+            "namespace": random.choice(["default", "monitoring", "backup"]),
+            "created": created,
+            "completed": completed,
+            "succeeded": 0,
+            "failed": random.randint(1, 6),
+        },
+    )
+    del failed_jobs[5:]
+
+
+def update_nodes():
+    for node in nodes:
+        node["cpu_usage"] = random.randint(500, node["cpu_capacity"])
+        node["memory_usage"] = random.randint(node["memory_capacity"] // 4, node["memory_capacity"])
+        node["allocated_pods"] = random.randint(10, 60)
+        node["allocated_containers"] = node["allocated_pods"] * 2
+
+    container_starts["day"] += random.randint(0, 10)
+    container_starts["week"] += random.randint(0, 10)
+
+
+def get_stats():
+    return {
+        "version": version,
+        "container_starts": container_starts,
+        "last_builds": builds,
+        "last_failed_builds": failed_builds,
+        "nodes": nodes,
+        "last_failed_jobs": failed_jobs,
+    }
+
+
+def mutate():
+    global version
+
+    while True:
+        time.sleep(change_interval)
+
+        with condition:
+            random.choice([add_build, add_build, add_failed_job, update_nodes])()
+            version += 1
+            print(f"Statistics changed, now at version {version}")
+            condition.notify_all()
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_GET(self):
+        url = urlparse(self.path)
+
+        if url.path == "/stats":
+            with condition:
+                body = json.dumps(get_stats())
+            self.send_stats(body)
+        elif url.path == "/stats/push":
+            query = parse_qs(url.query)
+            known = int(query["version"][0]) if "version" in query else 0
+
+            with condition:
+                changed = condition.wait_for(lambda: version != known, HOLD_TIME)
+                body = json.dumps(get_stats()) if changed else None
+
+            if body:
+                self.send_stats(body)
+            else:
+                self.send_response(304)
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+        else:
+            self.send_error(404)
+
+    def send_stats(self, body):
+        body = body.encode()
+
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+
+for _ in range(5):
+    add_build()
+add_failed_job()
+
+threading.Thread(target=mutate, daemon=True).start()
+
+print(f"Serving statistics on port {port}, changing every {change_interval} s")
+
+ThreadingHTTPServer(("", port), Handler).serve_forever()
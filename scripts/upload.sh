@@ -2,12 +2,48 @@
 
 set -e
 
-TIMESTAMP=$(date -u +"%Y-%m-%dT%H:%M:%SZ")
-SIGNATURE=$(echo -n $TIMESTAMP | openssl dgst -sha256 -sign "$1" | base64)
-
-curl \
-    --output - \
-    -F "file=@$2" \
-    -F "timestamp=$TIMESTAMP" \
-    -F "signature=$SIGNATURE" \
-    http://iotsupport.iotsupport.svc.cluster.local/assetctl/upload.php
+# Usage: upload.sh [-z] <signing key> <file>
+#
+# Uploads the file and a detached signature of it as <file>.sig, which the
+# device checks OTA images against. With -z the file is uploaded zlib
+# compressed under the same name. The device recognizes compressed firmware
+# images and inflates them while installing. The signature always covers
+# the uncompressed file.
+
+upload() {
+    TIMESTAMP=$(date -u +"%Y-%m-%dT%H:%M:%SZ")
+    SIGNATURE=$(echo -n $TIMESTAMP | openssl dgst -sha256 -sign "$KEY" | base64)
+
+    curl \
+        --output - \
+        -F "file=@$1" \
+        -F "timestamp=$TIMESTAMP" \
+        -F "signature=$SIGNATURE" \
+        http://iotsupport.iotsupport.svc.cluster.local/assetctl/upload.php
+}
+
+COMPRESS=
+if [ "$1" = "-z" ]; then
+    COMPRESS=1
+    shift
+fi
+
+KEY="$1"
+
+TEMP=$(mktemp -d)
+trap 'rm -rf "$TEMP"' EXIT
+
+FILE="$TEMP/$(basename "$2")"
+
+if [ -n "$COMPRESS" ]; then
+    python3 -c 'import sys, zlib; sys.stdout.buffer.write(zlib.compress(sys.stdin.buffer.read(), 9))' <"$2" >"$FILE"
+
+    echo "Compressed $(wc -c <"$2") to $(wc -c <"$FILE") bytes"
+else
+    cp "$2" "$FILE"
+fi
+
+openssl dgst -sha256 -sign "$KEY" -out "$FILE.sig" "$2"
+
+upload "$FILE"
+upload "$FILE.sig"
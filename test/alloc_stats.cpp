@@ -0,0 +1,86 @@
+#include "alloc_stats.h"
+
+#include <malloc.h>
+
+#include <new>
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+}
+
+static AllocStats stats;
+
+static void track_allocate(void* ptr) {
+    if (ptr) {
+        stats.count++;
+        stats.current += malloc_usable_size(ptr);
+        if (stats.current > stats.peak) {
+            stats.peak = stats.current;
+        }
+    }
+}
+
+static void track_free(void* ptr) {
+    if (ptr) {
+        stats.current -= malloc_usable_size(ptr);
+    }
+}
+
+void alloc_stats_reset() {
+    stats.count = 0;
+    stats.peak = stats.current;
+}
+
+AllocStats alloc_stats_get() { return stats; }
+
+extern "C" {
+
+void* __wrap_malloc(size_t size) {
+    auto ptr = __real_malloc(size);
+    track_allocate(ptr);
+    return ptr;
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    auto ptr = __real_calloc(count, size);
+    track_allocate(ptr);
+    return ptr;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    const auto old_size = ptr ? malloc_usable_size(ptr) : 0;
+
+    auto result = __real_realloc(ptr, size);
+
+    // A failed realloc leaves the original allocation alone.
+    if (result || !size) {
+        stats.current -= old_size;
+        track_allocate(result);
+    }
+
+    return result;
+}
+
+void __wrap_free(void* ptr) {
+    track_free(ptr);
+    __real_free(ptr);
+}
+}
+
+void* operator new(size_t size) {
+    auto ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+
+// Counts heap allocations made by the benchmarks. Linking alloc_stats.cpp
+// with -Wl,--wrap for malloc, calloc, realloc and free routes every
+// allocation through it, including operator new and cJSON.
+struct AllocStats {
+    size_t count;
+    size_t current;
+    size_t peak;
+};
+
+// Zeroes the count and starts measuring the peak from the current usage.
+void alloc_stats_reset();
+AllocStats alloc_stats_get();
@@ -0,0 +1,55 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Runs a libFuzzer entry point over files and directories of inputs, for
+// compilers without libFuzzer and to run the corpus as a test.
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static bool run(const std::filesystem::path& path) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        fprintf(stderr, "Failed to open %s\n", path.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    auto count = 0;
+
+    for (auto i = 1; i < argc; i++) {
+        std::filesystem::path path(argv[i]);
+
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path)) {
+                if (entry.is_regular_file()) {
+                    if (!run(entry.path())) {
+                        return 1;
+                    }
+                    count++;
+                }
+            }
+        } else {
+            if (!run(path)) {
+                return 1;
+            }
+            count++;
+        }
+    }
+
+    printf("Ran %d inputs\n", count);
+
+    return count > 0 ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+import json
+import random
+import sys
+
+# Writes the seed corpus for stats_fuzz and stats_bench: statistics payloads
+# shaped like the ones the statistics service sends (see
+# scripts/stats-server.py), from 1 KB up to the 128 KB the device reads.
+#
+#   python test/generate-corpus.py <directory>
+#
+# The payloads are grown by adding elements, up to the 64 per array the
+# device accepts, and then by adding Kubernetes labels to the nodes. The
+# device ignores the labels, but still has to parse them.
+
+SIZES = [1024, 4 * 1024, 16 * 1024, 64 * 1024, 128 * 1024 - 1]
+MAX_ARRAY_LENGTH = 64
+NOW = 1700000000
+
+
+def make_build(i, failed):
+    rng = random.Random(f"build-{i}-{failed}")
+    statuses = ["FAILURE", "UNSTABLE"] if failed else ["SUCCESS", "SUCCESS", "SUCCESS", "FAILURE", "IN_PROGRESS"]
+    return {
+        "name": rng.choice(["backend", "frontend", "infra", "docs", "infra-statistics-display"]),
+        "number": 10000 - i,
+        "execution": NOW - i * 600,
+        "status": rng.choice(statuses),
+    }
+
+
+def make_node(i, labels):
+    rng = random.Random(f"node-{i}")
+    return {
+        "name": f"node-{i}",
+        "created": NOW - 86400 * (30 + i),
+        "allocated_pods": rng.randint(10, 110),
+        "allocated_containers": rng.randint(20, 220),
+        "cpu_capacity": 8000,
+        "cpu_usage": rng.randint(500, 8000),
+        "memory_capacity": 32 * 1024 * 1024 * 1024,
+        "memory_usage": rng.randint(8, 32) * 1024 * 1024 * 1024,
+        "labels": {f"node.kubernetes.io/label-{j}": f"value-{rng.randint(0, 1 << 32):08x}" for j in range(labels)},
+    }
+
+
+def make_job(i):
+    rng = random.Random(f"job-{i}")
+    created = NOW - rng.randint(60, 86400)
+    return {
+        "name": f"cleanup-{rng.randint(1000, 9999)}",
+        "namespace": rng.choice(["default", "monitoring", "backup"]),
+        "created": created,
+        "completed": rng.choice([None, created + rng.randint(10, 60)]),
+        "succeeded": 0,
+        "failed": rng.randint(1, 6),
+    }
+
+
+def make_payload(step):
+    # Every step adds a build, a failed build, a node or a failed job in
+    # turn, and once all arrays are full, a label to one of the nodes.
+    elements = min(step, 4 * MAX_ARRAY_LENGTH)
+    counts = [elements // 4 + (1 if i < elements % 4 else 0) for i in range(4)]
+    labels = max(step - elements, 0)
+
+    stats = {
+        "version": 42,
+        "container_starts": {"day": 120, "week": 840},
+        "last_builds": [make_build(i, False) for i in range(counts[0])],
+        "last_failed_builds": [make_build(i, True) for i in range(counts[1])],
+        "nodes": [
+            make_node(i, labels // MAX_ARRAY_LENGTH + (1 if i < labels % MAX_ARRAY_LENGTH else 0))
+            for i in range(counts[2])
+        ],
+        "last_failed_jobs": [make_job(i) for i in range(counts[3])],
+    }
+
+    return json.dumps(stats).encode()
+
+
+def find_payload(size):
+    # The payload grows with every step; find the largest that fits.
+    low, high = 0, 1
+    while len(make_payload(high)) <= size:
+        low, high = high, high * 2
+
+    while high - low > 1:
+        middle = (low + high) // 2
+        if len(make_payload(middle)) <= size:
+            low = middle
+        else:
+            high = middle
+
+    return make_payload(low)
+
+
+if len(sys.argv) != 2:
+    print(f"usage: {sys.argv[0]} <directory>", file=sys.stderr)
+    sys.exit(1)
+
+for size in SIZES:
+    payload = find_payload(size)
+    with open(f"{sys.argv[1]}/stats-{(size + 1) // 1024}k.json", "wb") as f:
+        f.write(payload)
@@ -0,0 +1,152 @@
+#include "includes.h"
+
+#include <chrono>
+
+#include "NdjsonWriter.h"
+#include "alloc_stats.h"
+
+// Benchmarks serializing a batch of log messages with NdjsonWriter against
+// the cJSON object per message that LogManager used before, and checks that
+// both produce the same objects.
+
+constexpr auto MESSAGES = 1000;
+constexpr auto ENTITY_ID = "sensor.esp32_infra_statistics_display";
+
+struct Message {
+    string text;
+    uint32_t relative_time;
+};
+
+static vector<Message> create_messages() {
+    static const char* TAGS[] = {"StatsUI", "LogManager", "HttpConnectionManager", "OTAManager", "Application"};
+    static const char* TEXTS[] = {
+        "Downloading statistics",
+        "Parsed statistics with %d nodes in %d ms",
+        "Connection to \"https://example.com/api\" failed with error %d",
+        "Free heap %d bytes, largest block %d bytes",
+        "Path C:\\firmware\\update.bin\twas not found",
+    };
+
+    vector<Message> messages;
+    char text[256];
+
+    for (auto i = 0; i < MESSAGES; i++) {
+        const auto level = "EWID"[i % 4];
+        const auto color = level == 'E' ? "31" : level == 'W' ? "33" : "32";
+        auto length = snprintf(text, sizeof(text), "\033[0;%sm%c (%d) %s: ", color, level, i * 37,
+                               TAGS[i % size(TAGS)]);
+        length += snprintf(text + length, sizeof(text) - length, TEXTS[i % size(TEXTS)], i, i * 3);
+        snprintf(text + length, sizeof(text) - length, "\033[0m\n");
+
+        messages.push_back({text, (uint32_t)i * 37});
+    }
+
+    return messages;
+}
+
+static void append_cjson(string& buffer, const Message& message) {
+    auto root = cJSON_CreateObject();
+
+    cJSON_AddStringToObject(root, "message", message.text.c_str());
+    cJSON_AddNumberToObject(root, "relative_time", message.relative_time);
+    cJSON_AddStringToObject(root, "entity_id", ENTITY_ID);
+
+    auto json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    buffer.append(json);
+    buffer.append("\n");
+
+    cJSON_free(json);
+}
+
+static void append_ndjson(string& buffer, const Message& message) {
+    NdjsonWriter writer(buffer);
+
+    writer.begin_object();
+    writer.add_string("message", message.text.c_str());
+    writer.add_number("relative_time", message.relative_time);
+    writer.add_string("entity_id", ENTITY_ID);
+    writer.end_object();
+}
+
+template <typename Append>
+static void serialize(string& buffer, const vector<Message>& messages, Append append) {
+    buffer.clear();
+    for (const auto& message : messages) {
+        append(buffer, message);
+    }
+}
+
+template <typename Append>
+static void bench(const char* name, const vector<Message>& messages, Append append) {
+    string buffer;
+
+    // Warm up the buffer like the reused upload buffer on the device.
+    serialize(buffer, messages, append);
+
+    alloc_stats_reset();
+    serialize(buffer, messages, append);
+    const auto allocations = alloc_stats_get();
+
+    auto iterations = 0;
+    double elapsed = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    while (iterations < 10 || elapsed < 250000) {
+        serialize(buffer, messages, append);
+        iterations++;
+        elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const auto per_batch = elapsed / iterations;
+
+    printf("%-10s %8zu %10.1f %8.1f %8zu %10zu\n", name, buffer.length(), per_batch, buffer.length() / per_batch,
+           allocations.count, allocations.peak - allocations.current);
+}
+
+static bool equal_objects(const char* expected, const char* actual) {
+    auto a = cJSON_Parse(expected);
+    auto b = cJSON_Parse(actual);
+
+    const auto equal = a && b && cJSON_Compare(a, b, true);
+
+    cJSON_Delete(a);
+    cJSON_Delete(b);
+
+    return equal;
+}
+
+static bool check(const vector<Message>& messages) {
+    string expected, actual;
+
+    for (const auto& message : messages) {
+        expected.clear();
+        actual.clear();
+
+        append_cjson(expected, message);
+        append_ndjson(actual, message);
+
+        if (!equal_objects(expected.c_str(), actual.c_str())) {
+            fprintf(stderr, "NdjsonWriter wrote %s instead of %s", actual.c_str(), expected.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    const auto messages = create_messages();
+
+    if (!check(messages)) {
+        return 1;
+    }
+
+    printf("%-10s %8s %10s %8s %8s %10s\n", "writer", "bytes", "us/batch", "MB/s", "allocs", "peak");
+
+    bench("cJSON", messages, append_cjson);
+    bench("NDJSON", messages, append_ndjson);
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include "includes.h"
+
+#include <chrono>
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:
+            return "ESP_OK";
+        case ESP_FAIL:
+            return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:
+            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:
+            return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:
+            return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:
+            return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:
+            return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:
+            return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:
+            return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE:
+            return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC:
+            return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION:
+            return "ESP_ERR_INVALID_VERSION";
+        default:
+            return "UNKNOWN ERROR";
+    }
+}
+
+int64_t esp_timer_get_time() {
+    static const auto start = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void host_log(char level, const char* tag, const char* format, ...) {
+    static const auto enabled = getenv("HOST_LOG") != nullptr;
+    if (!enabled) {
+        return;
+    }
+
+    va_list va;
+    va_start(va, format);
+
+    fprintf(stderr, "%c (%d) %s: ", level, (int)(esp_timer_get_time() / 1000), tag);
+    vfprintf(stderr, format, va);
+    fputc('\n', stderr);
+
+    va_end(va);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// Stand-ins for the ESP-IDF APIs used by the firmware sources that are built
+// for the host. Included ahead of every source file; the sources themselves
+// are built with LV_SIMULATOR defined, like in the simulator.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#define ESP_ERR_TIMEOUT 0x107
+#define ESP_ERR_INVALID_RESPONSE 0x108
+#define ESP_ERR_INVALID_CRC 0x109
+#define ESP_ERR_INVALID_VERSION 0x10A
+
+const char* esp_err_to_name(esp_err_t code);
+int64_t esp_timer_get_time();
+
+// support.h maps localtime_r to the Windows localtime_s for the simulator.
+inline int localtime_s(struct tm* result, const time_t* time) { return localtime_r(time, result) ? 0 : -1; }
+
+// Log messages are dropped unless the HOST_LOG environment variable is set,
+// so fuzzing and benchmarks don't spend their time printing.
+void host_log(char level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, format, ...) host_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) host_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) host_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) host_log('D', tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) host_log('V', tag, format, ##__VA_ARGS__)
@@ -0,0 +1,3 @@
+#pragma once
+
+// includes.h pulls in LVGL; none of the sources built for the host use it.
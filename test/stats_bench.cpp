@@ -0,0 +1,103 @@
+#include "includes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "StatsDto.h"
+#include "alloc_stats.h"
+
+// Benchmarks StatsDto::from_json over the payloads given on the command line,
+// or the generated corpus. For every payload it reports the parse time, the
+// allocations of the first parse and of a parse into a reused StatsDto (the
+// steady state on the device), and the peak heap use during a parse.
+
+static string read_file(const std::filesystem::path& path) {
+    std::ifstream stream(path, std::ios::binary);
+    return string((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+}
+
+struct Measurement {
+    size_t allocations;
+    size_t peak;
+};
+
+static Measurement measure(const string& json, StatsDto& stats) {
+    alloc_stats_reset();
+    const auto before = alloc_stats_get().current;
+
+    StatsDto::from_json(json.c_str(), stats);
+
+    const auto after = alloc_stats_get();
+
+    return {after.count, after.peak - before};
+}
+
+static bool bench(const std::filesystem::path& path) {
+    const auto json = read_file(path);
+
+    auto stats = new StatsDto();
+
+    if (!StatsDto::from_json(json.c_str(), *stats)) {
+        fprintf(stderr, "Failed to parse %s\n", path.c_str());
+        delete stats;
+        return false;
+    }
+
+    delete stats;
+    stats = new StatsDto();
+
+    const auto cold = measure(json, *stats);
+    // Steady state: the vectors and the arena keep their memory.
+    const auto reused = measure(json, *stats);
+
+    auto iterations = 0;
+    double elapsed = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    while (iterations < 10 || elapsed < 250000) {
+        StatsDto::from_json(json.c_str(), *stats);
+        iterations++;
+        elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const auto per_parse = elapsed / iterations;
+
+    printf("%-24s %8zu %10.1f %8.1f %8zu %8zu %10zu %10zu\n", path.filename().c_str(), json.length(), per_parse,
+           json.length() / per_parse, cold.allocations, reused.allocations, cold.peak, reused.peak);
+
+    delete stats;
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    vector<std::filesystem::path> paths;
+
+    if (argc > 1) {
+        for (auto i = 1; i < argc; i++) {
+            paths.emplace_back(argv[i]);
+        }
+    } else {
+        for (const auto& entry : std::filesystem::directory_iterator(CORPUS_DIR)) {
+            paths.push_back(entry.path());
+        }
+    }
+
+    sort(paths.begin(), paths.end(), [](const auto& a, const auto& b) {
+        return std::filesystem::file_size(a) < std::filesystem::file_size(b);
+    });
+
+    printf("%-24s %8s %10s %8s %8s %8s %10s %10s\n", "payload", "bytes", "us/parse", "MB/s", "allocs", "reused",
+           "peak", "reused");
+
+    for (const auto& path : paths) {
+        if (!bench(path)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "includes.h"
+
+#include "StatsDto.h"
+
+// libFuzzer entry point for StatsDto::from_json, the only code that parses
+// data received from the network. Also built into stats_fuzz_replay, which
+// runs the inputs given on the command line without libFuzzer.
+
+static void check(bool condition, const char* message) {
+    if (!condition) {
+        fprintf(stderr, "Invariant failed: %s\n", message);
+        abort();
+    }
+}
+
+static void check_string(const char* value) {
+    check(value != nullptr, "string is null");
+    // Reads the string, so ASan catches strings that aren't terminated or
+    // point outside the arena.
+    check(strlen(value) < 128 * 1024, "string is longer than the payload");
+}
+
+static void check_stats(const StatsDto& stats) {
+    for (auto builds : {&stats.last_builds, &stats.last_failed_builds}) {
+        for (const auto& build : *builds) {
+            check_string(build.name);
+        }
+    }
+
+    for (const auto& job : stats.last_failed_jobs) {
+        check_string(job.name);
+        check_string(job.ns);
+    }
+
+    const auto& metrics = stats.node_metrics;
+    const auto count = stats.nodes.size();
+
+    check(metrics.size() == count && metrics.cpu_percentages.size() == count &&
+              metrics.memory_percentages.size() == count && metrics.cpu_labels.size() == count &&
+              metrics.memory_labels.size() == count && metrics.pods_labels.size() == count &&
+              metrics.containers_labels.size() == count && metrics.flags.size() == count,
+          "node metrics don't match the nodes");
+
+    for (size_t i = 0; i < count; i++) {
+        check_string(metrics.names[i]);
+        check_string(metrics.cpu_labels[i]);
+        check_string(metrics.memory_labels[i]);
+        check_string(metrics.pods_labels[i]);
+        check_string(metrics.containers_labels[i]);
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    // Reused across inputs like the device reuses it across updates, so
+    // stale state left behind by an earlier input shows up too.
+    static StatsDto stats;
+    static string json;
+
+    json.assign((const char*)data, size);
+
+    if (StatsDto::from_json(json.c_str(), stats)) {
+        check_stats(stats);
+    }
+
+    return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Minimal checks for the host tests. A failed check prints its location and
+// exits, which fails the test.
+
+#define CHECK(x)                                                                     \
+    do {                                                                             \
+        if (!(x)) {                                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+            exit(1);                                                                 \
+        }                                                                            \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                                          \
+    do {                                                                                                        \
+        const auto a_ = (a);                                                                                    \
+        const auto b_ = (b);                                                                                    \
+        if (!(a_ == b_)) {                                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, \
+                    (long long)a_, (long long)b_);                                                              \
+            exit(1);                                                                                            \
+        }                                                                                                       \
+    } while (0)
@@ -0,0 +1,203 @@
+#include "includes.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+#include "DeltaPatcher.h"
+#include "test.h"
+
+// Creates patches with scripts/ota-delta.py and checks that DeltaPatcher
+// reproduces the target when the patch arrives in chunks of random sizes,
+// like the HTTP client hands it over.
+
+constexpr size_t VERSION_OFFSET = 24 + 8 + 16;
+
+using Image = vector<uint8_t>;
+
+static std::mt19937 random_engine(46);
+
+static Image random_image(size_t length) {
+    Image image(length);
+    for (auto& b : image) {
+        b = (uint8_t)random_engine();
+    }
+    return image;
+}
+
+static void set_version(Image& image, const char* version) {
+    memset(image.data() + VERSION_OFFSET, 0, DeltaPatcher::VERSION_SIZE);
+    memcpy(image.data() + VERSION_OFFSET, version, strlen(version));
+}
+
+// A firmware update: most of the image stays, some of it moves, and code
+// is changed, inserted and removed in between.
+static Image edit_image(const Image& source) {
+    Image target;
+    size_t position = 0;
+
+    while (position < source.size()) {
+        const auto length = min(source.size() - position, (size_t)(random_engine() % 20000));
+
+        switch (random_engine() % 5) {
+            case 0: {
+                const auto inserted = random_image(random_engine() % 500);
+                target.insert(target.end(), inserted.begin(), inserted.end());
+                break;
+            }
+            case 1:
+                // Removed.
+                position += min(source.size() - position, (size_t)(random_engine() % 2000));
+                continue;
+            case 2: {
+                // Moved from elsewhere.
+                const auto offset = random_engine() % (source.size() - length + 1);
+                target.insert(target.end(), source.begin() + offset, source.begin() + offset + length);
+                break;
+            }
+            default:
+                break;
+        }
+
+        target.insert(target.end(), source.begin() + position, source.begin() + position + length);
+        position += length;
+
+        // Changed bytes, like a relocated address.
+        if (!target.empty() && random_engine() % 2) {
+            target[random_engine() % target.size()] ^= 0xff;
+        }
+    }
+
+    return target;
+}
+
+static void write_file(const std::filesystem::path& path, const Image& data) {
+    std::ofstream stream(path, std::ios::binary);
+    stream.write((const char*)data.data(), data.size());
+}
+
+static Image read_file(const std::filesystem::path& path) {
+    std::ifstream stream(path, std::ios::binary);
+    return Image((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+}
+
+static Image create_patch(const Image& source, const Image& target) {
+    const auto directory = std::filesystem::path(WORK_DIR);
+    std::filesystem::create_directories(directory);
+
+    const auto source_path = directory / "source.bin";
+    const auto target_path = directory / "target.bin";
+    const auto patch_path = directory / "patch.bin";
+
+    write_file(source_path, source);
+    write_file(target_path, target);
+    std::filesystem::remove(patch_path);
+
+    const auto command = string("\"") + PYTHON_EXECUTABLE + "\" \"" + OTA_DELTA_SCRIPT + "\" create \"" +
+                         source_path.string() + "\" \"" + target_path.string() + "\" \"" + patch_path.string() +
+                         "\" > /dev/null";
+    CHECK_EQ(system(command.c_str()), 0);
+
+    return read_file(patch_path);
+}
+
+struct Result {
+    esp_err_t write;
+    esp_err_t finish;
+    Image target;
+};
+
+static Result apply_patch(const Image& source, const Image& patch, size_t max_chunk) {
+    Result result = {ESP_OK, ESP_OK, {}};
+
+    DeltaPatcher patcher(
+        [&](size_t offset, uint8_t* target, size_t length) {
+            CHECK(offset + length <= source.size());
+            memcpy(target, source.data() + offset, length);
+            return ESP_OK;
+        },
+        [&](const uint8_t* data, size_t length) {
+            result.target.insert(result.target.end(), data, data + length);
+            return ESP_OK;
+        });
+
+    size_t position = 0;
+    while (position < patch.size()) {
+        // Favor small chunks, which split the fields.
+        const auto limit = random_engine() % 4 ? min(max_chunk, (size_t)16) : max_chunk;
+        const auto chunk = min(patch.size() - position, 1 + random_engine() % limit);
+
+        result.write = patcher.write(patch.data() + position, chunk);
+        if (result.write != ESP_OK) {
+            return result;
+        }
+
+        position += chunk;
+    }
+
+    result.finish = patcher.finish();
+
+    if (patcher.has_header()) {
+        CHECK_EQ(patcher.get_source_size(), source.size());
+        CHECK(memcmp(patcher.get_source_version(), source.data() + VERSION_OFFSET, DeltaPatcher::VERSION_SIZE) ==
+              0);
+    }
+
+    return result;
+}
+
+static void check_patch(const Image& source, const Image& target) {
+    const auto patch = create_patch(source, target);
+    CHECK(patch.size() > DeltaPatcher::HEADER_SIZE);
+
+    for (auto max_chunk : {(size_t)1, (size_t)7, (size_t)100, (size_t)4096, (size_t)65536, patch.size()}) {
+        const auto result = apply_patch(source, patch, max_chunk);
+        CHECK_EQ(result.write, ESP_OK);
+        CHECK_EQ(result.finish, ESP_OK);
+        CHECK(result.target == target);
+    }
+
+    // A patch that was cut off doesn't finish.
+    const Image truncated(patch.begin(), patch.end() - 1);
+    CHECK_EQ(apply_patch(source, truncated, 4096).finish, ESP_ERR_INVALID_SIZE);
+
+    // Nothing may follow the end.
+    auto extended = patch;
+    extended.push_back(0);
+    CHECK_EQ(apply_patch(source, extended, 4096).write, ESP_ERR_INVALID_SIZE);
+}
+
+int main() {
+    auto source = random_image(300000);
+    set_version(source, "1.0.0");
+
+    auto target = edit_image(source);
+    set_version(target, "1.1.0");
+
+    check_patch(source, target);
+
+    // Only copies, and only inserts.
+    check_patch(source, source);
+    check_patch(source, random_image(20000));
+
+    // Tiny targets, which have no room for a match.
+    check_patch(source, Image{1, 2, 3});
+
+    for (auto i = 0; i < 5; i++) {
+        check_patch(source, edit_image(source));
+    }
+
+    // Not a patch.
+    auto patch = create_patch(source, target);
+    patch[0] ^= 0xff;
+    CHECK_EQ(apply_patch(source, patch, 4096).write, ESP_ERR_INVALID_VERSION);
+
+    // A copy beyond the end of the source.
+    patch = create_patch(source, source);
+    const uint32_t offset = source.size();
+    memcpy(patch.data() + DeltaPatcher::HEADER_SIZE + 1, &offset, sizeof(offset));
+    CHECK_EQ(apply_patch(source, patch, 4096).write, ESP_ERR_INVALID_SIZE);
+
+    return 0;
+}
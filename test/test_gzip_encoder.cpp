@@ -0,0 +1,124 @@
+#include "includes.h"
+
+#include <random>
+
+#include <zlib.h>
+
+#include "GzipEncoder.h"
+#include "test.h"
+
+// Compresses a range of inputs with GzipEncoder and checks that zlib
+// decompresses them back to the input, and that the output stays within
+// get_max_size().
+
+static string decompress(const char* data, size_t length) {
+    z_stream stream = {};
+    // Expect a gzip header and trailer, whose CRC and size zlib checks.
+    CHECK_EQ(inflateInit2(&stream, 16 + MAX_WBITS), Z_OK);
+
+    stream.next_in = (Bytef*)data;
+    stream.avail_in = length;
+
+    string result;
+    char buffer[4096];
+    int err;
+
+    do {
+        stream.next_out = (Bytef*)buffer;
+        stream.avail_out = sizeof(buffer);
+
+        err = inflate(&stream, Z_NO_FLUSH);
+        if (err != Z_OK && err != Z_STREAM_END) {
+            fprintf(stderr, "inflate failed with %d: %s\n", err, stream.msg ? stream.msg : "");
+            exit(1);
+        }
+
+        result.append(buffer, sizeof(buffer) - stream.avail_out);
+    } while (err != Z_STREAM_END);
+
+    // The member ends exactly at the end of the output.
+    CHECK_EQ(stream.avail_in, 0u);
+
+    inflateEnd(&stream);
+
+    return result;
+}
+
+static void check_round_trip(GzipEncoder& encoder, const string& input) {
+    // encode() appends, so start with something in the target.
+    string target = "prefix";
+
+    encoder.encode(input.data(), input.length(), target);
+
+    CHECK(target.compare(0, 6, "prefix") == 0);
+    CHECK(target.length() - 6 <= GzipEncoder::get_max_size(input.length()));
+
+    if (decompress(target.data() + 6, target.length() - 6) != input) {
+        fprintf(stderr, "Round trip of %zu bytes failed\n", input.length());
+        exit(1);
+    }
+}
+
+static string create_log_batch(size_t length) {
+    string batch;
+    char line[256];
+
+    for (auto i = 0; batch.length() < length; i++) {
+        snprintf(line, sizeof(line),
+                 "{\"message\":\"\\u001b[0;32mI (%d) StatsUI: Parsed statistics with %d nodes\\u001b[0m\\n\","
+                 "\"relative_time\":%d}\n",
+                 i * 37, i % 7, i * 11);
+        batch.append(line);
+    }
+
+    batch.resize(length);
+
+    return batch;
+}
+
+int main() {
+    std::mt19937 random(42);
+    GzipEncoder encoder;
+
+    check_round_trip(encoder, "");
+    check_round_trip(encoder, "a");
+    check_round_trip(encoder, "ab");
+    check_round_trip(encoder, "abc");
+    check_round_trip(encoder, "abcabcabcabcabcabc");
+
+    // Matches up to the maximum length and runs much longer than that.
+    check_round_trip(encoder, string(258 + 3, 'x'));
+    check_round_trip(encoder, string(100000, 'x'));
+
+    for (auto length : {1000, 8192, 40000, 100000}) {
+        check_round_trip(encoder, create_log_batch(length));
+    }
+
+    // Incompressible data is stored as literals, which take the most space.
+    for (auto length : {1, 100, 8192, 70000}) {
+        string input(length, 0);
+        for (auto& c : input) {
+            c = (char)random();
+        }
+        check_round_trip(encoder, input);
+    }
+
+    // Repeats further apart than the window can't be matched.
+    string block(20000, 0);
+    for (auto& c : block) {
+        c = (char)random();
+    }
+    check_round_trip(encoder, block + block);
+    check_round_trip(encoder, block + string(20000, 'y') + block);
+
+    // Few symbols, so many short matches at all distances.
+    for (auto i = 0; i < 20; i++) {
+        string input(random() % 70000, 0);
+        for (auto& c : input) {
+            c = "abcd"[random() % 4];
+        }
+        check_round_trip(encoder, input);
+    }
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "includes.h"
+
+#include "LogFormat.h"
+#include "test.h"
+
+// Checks that captured arguments render like vsnprintf, and that capture()
+// stays within the measured length when a string changes between measuring
+// and capturing.
+
+static void check_round_trip(const char* format, ...) {
+    va_list va;
+    va_start(va, format);
+
+    char expected[256];
+    va_list vaCopy;
+    va_copy(vaCopy, va);
+    vsnprintf(expected, sizeof(expected), format, vaCopy);
+    va_end(vaCopy);
+
+    size_t string_length;
+    const auto length = LogFormat::measure(format, va, string_length);
+    CHECK(length >= 0);
+
+    vector<uint8_t> args(length);
+    LogFormat::capture(format, va, args.data(), length, string_length);
+
+    va_end(va);
+
+    char actual[256];
+    CHECK_EQ(LogFormat::render(format, args.data(), args.size(), actual, sizeof(actual)), (int)strlen(expected));
+    if (strcmp(actual, expected) != 0) {
+        fprintf(stderr, "'%s' rendered as '%s' instead of '%s'\n", format, actual, expected);
+        exit(1);
+    }
+}
+
+static int measure(size_t& string_length, const char* format, ...) {
+    va_list va;
+    va_start(va, format);
+    const auto length = LogFormat::measure(format, va, string_length);
+    va_end(va);
+    return length;
+}
+
+static void capture(uint8_t* target, size_t length, size_t string_length, const char* format, ...) {
+    va_list va;
+    va_start(va, format);
+    LogFormat::capture(format, va, target, length, string_length);
+    va_end(va);
+}
+
+static void check_changed_string(const char* measured, const char* captured, const char* expected) {
+    const auto format = "%s and %d";
+    constexpr uint8_t CANARY = 0xa5;
+
+    size_t string_length;
+    const auto length = measure(string_length, format, measured, 42);
+    CHECK_EQ(string_length, strlen(measured));
+
+    vector<uint8_t> args(length + 16, CANARY);
+    capture(args.data(), length, string_length, format, captured, 42);
+
+    for (auto i = length; i < (int)args.size(); i++) {
+        CHECK_EQ(args[i], CANARY);
+    }
+
+    char actual[256];
+    LogFormat::render(format, args.data(), length, actual, sizeof(actual));
+    CHECK(strcmp(actual, expected) == 0);
+}
+
+int main() {
+    check_round_trip("no arguments");
+    check_round_trip("%d %i %u %x %X %o %c %%", -1, 2, 3u, 0xabu, 0xcdu, 8, 'c');
+    check_round_trip("%lld %llu %zu %jd", -1234567890123ll, 1234567890123ull, (size_t)42, (intmax_t)-7);
+    check_round_trip("%f %.2f %e %g %8.3f", 1.5, 2.25, 1e10, 0.1, -3.14159);
+    check_round_trip("%s|%.3s|%10s|%-10s|%s", "text", "truncated", "right", "left", (const char*)nullptr);
+    check_round_trip("%*d|%-*d|%.*s", 6, 42, 6, 42, 2, "precision");
+    check_round_trip("%p", (void*)0x1234);
+    check_round_trip("\033[0;32mI (%lu) %s: %s\033[0m\n", 1000ul, "tag", "message");
+
+    // Unsupported conversions can't be deferred.
+    size_t string_length;
+    CHECK_EQ(measure(string_length, "%n", nullptr), -1);
+    CHECK_EQ(measure(string_length, "%Lf", (long double)1), -1);
+
+    // A string that grew is cut off at its measured length, one that shrank
+    // leaves zeroed space behind.
+    check_changed_string("abc", "abcdefghijklmnopqrstuvwxyz", "abc and 42");
+    check_changed_string("abcdefghijklmnopqrstuvwxyz", "abc", "abc and 42");
+    check_changed_string("", "abc", " and 42");
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "includes.h"
+
+#include <thread>
+
+#include "LogRing.h"
+#include "test.h"
+
+// Runs producers on several threads against a concurrent consumer and checks
+// that every record that comes out is intact, that the records of a producer
+// come out in order, and that every record is either read or counted as
+// dropped.
+
+constexpr auto PRODUCERS = 4;
+constexpr auto RECORDS = 50000;
+constexpr auto MAX_LENGTH = 200;
+
+struct Record {
+    uint32_t producer;
+    uint32_t sequence;
+    uint32_t length;
+};
+
+static uint8_t get_fill(const Record& record, uint32_t i) { return (uint8_t)(record.producer * 31 + record.sequence + i); }
+
+static void produce(LogRing& ring, uint32_t producer) {
+    uint32_t seed = producer + 1;
+
+    for (uint32_t sequence = 0; sequence < RECORDS; sequence++) {
+        // Lengths vary so records end at every offset and padding records
+        // are needed at the end of the buffer.
+        seed = seed * 1103515245 + 12345;
+        const Record record = {producer, sequence, (uint32_t)(sizeof(Record) + (seed >> 16) % MAX_LENGTH)};
+
+        auto reservation = ring.reserve(record.length);
+        if (!reservation) {
+            // Give the consumer a chance to catch up.
+            std::this_thread::yield();
+            continue;
+        }
+
+        memcpy(reservation.data, &record, sizeof(record));
+        for (auto i = (uint32_t)sizeof(record); i < record.length; i++) {
+            reservation.data[i] = get_fill(record, i);
+        }
+
+        ring.commit(reservation);
+
+        // With OverwriteOldest the producers never have to wait, and would
+        // leave the consumer nothing to read on a single core.
+        if (sequence % 16 == 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+static void run(LogRingPolicy policy, const char* name) {
+    LogRing ring(4096, policy);
+    std::atomic<int> running(PRODUCERS);
+    int64_t next[PRODUCERS] = {};
+    uint32_t received = 0;
+    uint8_t buffer[sizeof(Record) + MAX_LENGTH];
+
+    auto consume = [&]() {
+        auto length = ring.read(buffer, sizeof(buffer));
+        if (!length) {
+            return false;
+        }
+
+        Record record;
+        CHECK(length >= sizeof(record));
+        memcpy(&record, buffer, sizeof(record));
+
+        CHECK(record.producer < PRODUCERS);
+        CHECK_EQ(record.length, length);
+        for (auto i = (uint32_t)sizeof(record); i < length; i++) {
+            CHECK_EQ(buffer[i], get_fill(record, i));
+        }
+
+        // Records may be dropped, but never reordered or repeated.
+        CHECK(record.sequence >= next[record.producer]);
+        next[record.producer] = record.sequence + 1;
+
+        received++;
+        return true;
+    };
+
+    vector<std::thread> producers;
+    for (auto i = 0; i < PRODUCERS; i++) {
+        producers.emplace_back([&, i]() {
+            produce(ring, i);
+            running--;
+        });
+    }
+
+    while (running) {
+        if (!consume()) {
+            std::this_thread::yield();
+        }
+    }
+
+    for (auto& producer : producers) {
+        producer.join();
+    }
+
+    while (consume()) {
+    }
+
+    CHECK(ring.empty());
+    CHECK_EQ(received + ring.get_dropped(), (uint32_t)(PRODUCERS * RECORDS));
+
+    printf("%s: received %u, dropped %u\n", name, received, ring.get_dropped());
+}
+
+int main() {
+    run(LogRingPolicy::DropNewest, "DropNewest");
+    run(LogRingPolicy::OverwriteOldest, "OverwriteOldest");
+
+    return 0;
+}
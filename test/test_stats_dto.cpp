@@ -0,0 +1,178 @@
+#include "includes.h"
+
+#include <climits>
+
+#include "StatsDto.h"
+#include "test.h"
+
+// Parses small payloads and checks the node metrics StatsDto derives from
+// them.
+
+static void parse(StatsDto& stats, const string& json) {
+    if (!StatsDto::from_json(json.c_str(), stats)) {
+        fprintf(stderr, "Failed to parse %s\n", json.c_str());
+        exit(1);
+    }
+}
+
+// Numbers are passed as text, so they can be written as JSON has them.
+static string node(const char* name, const char* pods, const char* containers, const char* cpu_capacity,
+                   const char* cpu_usage, const char* memory_capacity, const char* memory_usage) {
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer),
+             R"({"name": "%s", "created": 0, "allocated_pods": %s, "allocated_containers": %s, "cpu_capacity": %s, )"
+             R"("cpu_usage": %s, "memory_capacity": %s, "memory_usage": %s})",
+             name, pods, containers, cpu_capacity, cpu_usage, memory_capacity, memory_usage);
+    return buffer;
+}
+
+static void parse_nodes(StatsDto& stats, const vector<string>& nodes) {
+    string json = R"({"nodes": [)";
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (i) {
+            json += ", ";
+        }
+        json += nodes[i];
+    }
+    json += "]}";
+
+    parse(stats, json);
+}
+
+static void check_label(const char* actual, const char* expected) {
+    if (!actual || strcmp(actual, expected) != 0) {
+        fprintf(stderr, "Label is '%s' instead of '%s'\n", actual ? actual : "(null)", expected);
+        exit(1);
+    }
+}
+
+static void test_percentages() {
+    StatsDto stats;
+    parse_nodes(stats, {node("a", "12", "30", "4000", "1000", "16000", "12000"),
+                        node("b", "0", "0", "3", "2", "1000", "999"),
+                        node("c", "1", "2", "1000", "1500", "1000", "0"),
+                        node("d", "1", "1", "1000", "-5", "1000", "5")});
+
+    const auto& metrics = stats.node_metrics;
+    CHECK_EQ(metrics.size(), 4u);
+
+    check_label(metrics.names[0], "a");
+    check_label(metrics.names[3], "d");
+
+    // Percentages are rounded down.
+    CHECK_EQ(metrics.cpu_percentages[0], 25);
+    check_label(metrics.cpu_labels[0], "25%");
+    CHECK_EQ(metrics.memory_percentages[0], 75);
+    check_label(metrics.memory_labels[0], "75%");
+
+    CHECK_EQ(metrics.cpu_percentages[1], 66);
+    check_label(metrics.cpu_labels[1], "66%");
+    CHECK_EQ(metrics.memory_percentages[1], 99);
+    check_label(metrics.memory_labels[1], "99%");
+
+    // Overcommitted nodes go past 100%.
+    CHECK_EQ(metrics.cpu_percentages[2], 150);
+    check_label(metrics.cpu_labels[2], "150%");
+    CHECK_EQ(metrics.memory_percentages[2], 0);
+    check_label(metrics.memory_labels[2], "0%");
+
+    // Negative usage counts as none.
+    CHECK_EQ(metrics.cpu_percentages[3], 0);
+    check_label(metrics.cpu_labels[3], "0%");
+
+    for (size_t i = 0; i < metrics.size(); i++) {
+        CHECK_EQ(metrics.flags[i], 0);
+    }
+
+    check_label(metrics.pods_labels[0], "12");
+    check_label(metrics.containers_labels[0], "30");
+    check_label(metrics.pods_labels[1], "0");
+
+    CHECK_EQ(metrics.total_pods, 14);
+    CHECK_EQ(metrics.total_containers, 33);
+}
+
+static void test_unknown_capacity() {
+    StatsDto stats;
+    parse_nodes(stats, {node("a", "1", "1", "0", "100", "1000", "500"),
+                        node("b", "1", "1", "1000", "500", "-1", "500"),
+                        node("c", "1", "1", "-1000", "500", "0", "0")});
+
+    const auto& metrics = stats.node_metrics;
+    CHECK_EQ(metrics.size(), 3u);
+
+    CHECK_EQ(metrics.flags[0], NODE_CPU_UNKNOWN);
+    CHECK_EQ(metrics.cpu_percentages[0], 0);
+    check_label(metrics.cpu_labels[0], "-");
+    CHECK_EQ(metrics.memory_percentages[0], 50);
+    check_label(metrics.memory_labels[0], "50%");
+
+    CHECK_EQ(metrics.flags[1], NODE_MEMORY_UNKNOWN);
+    CHECK_EQ(metrics.cpu_percentages[1], 50);
+    CHECK_EQ(metrics.memory_percentages[1], 0);
+    check_label(metrics.memory_labels[1], "-");
+
+    CHECK_EQ(metrics.flags[2], NODE_CPU_UNKNOWN | NODE_MEMORY_UNKNOWN);
+    CHECK_EQ(metrics.cpu_percentages[2], 0);
+    CHECK_EQ(metrics.memory_percentages[2], 0);
+    check_label(metrics.cpu_labels[2], "-");
+    check_label(metrics.memory_labels[2], "-");
+}
+
+static void test_huge_usage() {
+    StatsDto stats;
+    // usage * 100 overflows an int64 for the first node, and only the
+    // quotient is too large for the second.
+    parse_nodes(stats, {node("a", "1", "1", "1", "1e17", "1000", "1000"),
+                        node("b", "1", "1", "1", "1000", "1", "700")});
+
+    const auto& metrics = stats.node_metrics;
+
+    CHECK_EQ(metrics.cpu_percentages[0], UINT16_MAX);
+    check_label(metrics.cpu_labels[0], "65535%");
+    CHECK_EQ(metrics.memory_percentages[0], 100);
+    CHECK_EQ(metrics.flags[0], 0);
+
+    CHECK_EQ(metrics.cpu_percentages[1], UINT16_MAX);
+    CHECK_EQ(metrics.memory_percentages[1], UINT16_MAX);
+}
+
+static void test_totals() {
+    StatsDto stats;
+    parse_nodes(stats, {node("a", "2147483647", "2000000000", "1", "0", "1", "0"),
+                        node("b", "1", "2000000000", "1", "0", "1", "0")});
+
+    CHECK_EQ(stats.node_metrics.total_pods, INT_MAX);
+    CHECK_EQ(stats.node_metrics.total_containers, INT_MAX);
+    check_label(stats.node_metrics.pods_labels[0], "2147483647");
+
+    // Values beyond an int are clamped while decoding, and the sum
+    // saturates at the bottom as well.
+    parse_nodes(stats, {node("a", "1e12", "-1e12", "1", "0", "1", "0"),
+                        node("b", "5", "-5", "1", "0", "1", "0")});
+
+    CHECK_EQ(stats.node_metrics.total_pods, INT_MAX);
+    CHECK_EQ(stats.node_metrics.total_containers, INT_MIN);
+
+    // Reparsing into the same StatsDto starts from scratch.
+    parse_nodes(stats, {node("a", "3", "4", "1", "0", "1", "0")});
+
+    CHECK_EQ(stats.node_metrics.size(), 1u);
+    CHECK_EQ(stats.node_metrics.total_pods, 3);
+    CHECK_EQ(stats.node_metrics.total_containers, 4);
+
+    parse(stats, "{}");
+
+    CHECK_EQ(stats.node_metrics.size(), 0u);
+    CHECK_EQ(stats.node_metrics.total_pods, 0);
+    CHECK_EQ(stats.node_metrics.total_containers, 0);
+}
+
+int main() {
+    test_percentages();
+    test_unknown_capacity();
+    test_huge_usage();
+    test_totals();
+
+    return 0;
+}
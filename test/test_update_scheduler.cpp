@@ -0,0 +1,174 @@
+#include "includes.h"
+
+#include "UpdateScheduler.h"
+#include "test.h"
+
+// Drives UpdateScheduler with fixed times in a fixed time zone two hours
+// ahead of UTC, so slots counted from UTC midnight would be off.
+
+constexpr int DURATION_MS = 10000;
+constexpr time_t LEAD = DURATION_MS / 1000;
+
+static const UpdateScheduler::Config CONFIG = {
+    .interval = 300,
+    .active_interval = 60,
+    .quiet_interval = 1800,
+    .quiet_start_hour = 23,
+    .quiet_end_hour = 6,
+    .retry_min = 10,
+    .retry_max = 600,
+};
+
+static time_t local_time(int hour, int minute, int second, int day = 19) {
+    tm time_info = {};
+    time_info.tm_year = 2026 - 1900;
+    time_info.tm_mon = 10 - 1;
+    time_info.tm_mday = day;
+    time_info.tm_hour = hour;
+    time_info.tm_min = minute;
+    time_info.tm_sec = second;
+    time_info.tm_isdst = -1;
+    return mktime(&time_info);
+}
+
+// The next update after a successful one at now, when updates take
+// DURATION_MS.
+static time_t next_after_success(const UpdateScheduler::Config& config, time_t now, bool active) {
+    UpdateScheduler scheduler(config, 1);
+    scheduler.succeeded(now, DURATION_MS, active);
+
+    CHECK(scheduler.get_next_update() > now);
+    CHECK(!scheduler.is_due(now));
+    CHECK(scheduler.is_due(scheduler.get_next_update()));
+
+    return scheduler.get_next_update();
+}
+
+static void test_alignment() {
+    const auto midnight = local_time(0, 0, 0);
+
+    // Slots start at multiples of the interval from local midnight, minus
+    // the lead.
+    CHECK_EQ(next_after_success(CONFIG, local_time(10, 0, 7), false), local_time(10, 5, 0) - LEAD);
+    CHECK_EQ(next_after_success(CONFIG, local_time(10, 4, 49), false), local_time(10, 5, 0) - LEAD);
+
+    // Once the lead of a slot has started, the next slot is the first
+    // one still ahead.
+    CHECK_EQ(next_after_success(CONFIG, local_time(10, 4, 50), false), local_time(10, 10, 0) - LEAD);
+    CHECK_EQ(next_after_success(CONFIG, local_time(10, 4, 55), false), local_time(10, 10, 0) - LEAD);
+
+    // An interval that doesn't divide the UTC offset: five hour slots fall
+    // on 0:00, 5:00, 10:00 and 15:00 local time.
+    auto config = CONFIG;
+    config.interval = 5 * 3600;
+
+    CHECK_EQ(next_after_success(config, local_time(10, 0, 7), false), local_time(15, 0, 0) - LEAD);
+    CHECK_EQ(next_after_success(config, local_time(16, 0, 0), false), local_time(20, 0, 0) - LEAD);
+
+    for (auto now = local_time(6, 0, 0); now < local_time(23, 0, 0); now += 37) {
+        const auto next = next_after_success(CONFIG, now, false);
+        CHECK((next + LEAD - midnight) % CONFIG.interval == 0);
+        CHECK(next - now <= CONFIG.interval);
+    }
+}
+
+static void test_active() {
+    CHECK_EQ(next_after_success(CONFIG, local_time(10, 0, 7), true), local_time(10, 1, 0) - LEAD);
+    CHECK_EQ(next_after_success(CONFIG, local_time(10, 0, 7), false), local_time(10, 5, 0) - LEAD);
+
+    // Quiet hours take precedence over changing data.
+    CHECK_EQ(next_after_success(CONFIG, local_time(2, 0, 7), true), local_time(2, 30, 0) - LEAD);
+}
+
+static void test_quiet() {
+    // A window that wraps past midnight, from 23:00 to 6:00.
+    CHECK_EQ(next_after_success(CONFIG, local_time(22, 59, 0), false), local_time(23, 0, 0) - LEAD);
+    CHECK_EQ(next_after_success(CONFIG, local_time(23, 0, 7), false), local_time(23, 30, 0) - LEAD);
+    CHECK_EQ(next_after_success(CONFIG, local_time(23, 30, 7), false), local_time(0, 0, 0, 20) - LEAD);
+    CHECK_EQ(next_after_success(CONFIG, local_time(0, 10, 0), false), local_time(0, 30, 0) - LEAD);
+    CHECK_EQ(next_after_success(CONFIG, local_time(5, 59, 0), false), local_time(6, 0, 0) - LEAD);
+    CHECK_EQ(next_after_success(CONFIG, local_time(6, 0, 7), false), local_time(6, 5, 0) - LEAD);
+
+    // A window within the day, from 12:00 to 14:00.
+    auto config = CONFIG;
+    config.quiet_start_hour = 12;
+    config.quiet_end_hour = 14;
+
+    CHECK_EQ(next_after_success(config, local_time(11, 59, 0), false), local_time(12, 0, 0) - LEAD);
+    CHECK_EQ(next_after_success(config, local_time(12, 0, 7), false), local_time(12, 30, 0) - LEAD);
+    CHECK_EQ(next_after_success(config, local_time(13, 59, 0), false), local_time(14, 0, 0) - LEAD);
+    CHECK_EQ(next_after_success(config, local_time(14, 0, 7), false), local_time(14, 5, 0) - LEAD);
+    CHECK_EQ(next_after_success(config, local_time(2, 0, 7), false), local_time(2, 5, 0) - LEAD);
+}
+
+static void test_duration() {
+    UpdateScheduler scheduler(CONFIG, 1);
+    const auto now = local_time(10, 0, 7);
+
+    CHECK_EQ(scheduler.get_duration_ms(), 10000);
+
+    // Each update moves the average a quarter of the way.
+    scheduler.succeeded(now, 2000, false);
+    CHECK_EQ(scheduler.get_duration_ms(), 8000);
+    scheduler.succeeded(now, 2000, false);
+    CHECK_EQ(scheduler.get_duration_ms(), 6500);
+    scheduler.succeeded(now, 30000, false);
+    CHECK_EQ(scheduler.get_duration_ms(), 12375);
+
+    // The lead is rounded up to whole seconds.
+    CHECK_EQ(scheduler.get_next_update(), local_time(10, 5, 0) - 13);
+
+    // Failures leave the average alone.
+    scheduler.failed(now);
+    CHECK_EQ(scheduler.get_duration_ms(), 12375);
+}
+
+static void check_backoff(UpdateScheduler& scheduler, time_t now, time_t expected) {
+    scheduler.failed(now);
+
+    const auto delay = scheduler.get_next_update() - now;
+    CHECK(delay >= expected * 75 / 100);
+    CHECK(delay <= expected * 125 / 100);
+}
+
+static void test_backoff() {
+    const auto now = local_time(10, 0, 7);
+    const time_t expected[] = {10, 20, 40, 80, 160, 320, 600, 600, 600};
+
+    for (uint32_t seed = 1; seed < 100; seed++) {
+        UpdateScheduler scheduler(CONFIG, seed);
+
+        for (auto delay : expected) {
+            check_backoff(scheduler, now, delay);
+        }
+
+        // Success starts the backoff over.
+        scheduler.succeeded(now, DURATION_MS, false);
+        check_backoff(scheduler, now, 10);
+        check_backoff(scheduler, now, 20);
+    }
+
+    // The jitter depends on the seed.
+    UpdateScheduler a(CONFIG, 1);
+    UpdateScheduler b(CONFIG, 2);
+    auto differs = false;
+    for (auto i = 0; i < 10; i++) {
+        a.failed(now);
+        b.failed(now);
+        differs |= a.get_next_update() != b.get_next_update();
+    }
+    CHECK(differs);
+}
+
+int main() {
+    setenv("TZ", "XST-2", 1);
+    tzset();
+
+    test_alignment();
+    test_active();
+    test_quiet();
+    test_duration();
+    test_backoff();
+
+    return 0;
+}